@@ -0,0 +1,183 @@
+/*
+ * @file emCircularBatch.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "emCircularBatch.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the index in the buffer of a sequence number. Indexes and sequence
+ * numbers of the tail always move together, so their difference is constant.
+ */
+static size_t emCircularBatchIndex(const CBBatchConsumer_t *consumer, const uint64_t seq)
+{
+	return (consumer->base + (size_t)(seq % consumer->ring->maxElems)) % consumer->ring->maxElems;
+}
+
+/*
+ * Moves the tail of the buffer over the batches done in order
+ */
+static void emCircularBatchAdvance(CBBatchConsumer_t *consumer)
+{
+	uint64_t seq = consumer->releasedSeq;
+	size_t index = emCircularBatchIndex(consumer, seq);
+	size_t nbElems = emCircularPort_AtomicLoad(&consumer->done[index]);
+	while (nbElems != 0)
+	{
+		emCircularPort_AtomicStore(&consumer->done[index], 0);
+		seq += nbElems;
+		index = emCircularBatchIndex(consumer, seq);
+		nbElems = emCircularPort_AtomicLoad(&consumer->done[index]);
+	}
+	if (seq != consumer->releasedSeq)
+	{
+		if (consumer->releaseFn != NULL)
+		{
+			consumer->releaseFn(consumer, consumer->releasedSeq, (size_t)(seq - consumer->releasedSeq),
+								consumer->releaseArg);
+		}
+		emCircularSeekTail(consumer->ring, seq);
+		emCircularPort_AtomicStore(&consumer->releasedSeq, seq);
+	}
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBBatchConsumer_t *emCircularBatchInit(CBuffer_t *ring, const size_t batchElems)
+{
+	if ((ring == NULL) || (batchElems < 1))
+		return NULL;
+	CBBatchConsumer_t *retval = (CBBatchConsumer_t *)emCircularPortMalloc(sizeof(CBBatchConsumer_t));
+	if (retval == NULL)
+		return NULL;
+	retval->done = (size_t *)emCircularPortMalloc(ring->maxElems * sizeof(size_t));
+	if (retval->done == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	for (size_t i = 0; i < ring->maxElems; i++)
+	{
+		retval->done[i] = 0;
+	}
+	uint64_t tailSeq = emCircularGetTailSeq(ring);
+	retval->ring = ring;
+	retval->batchElems = batchElems;
+	retval->base = (ring->tailInd + ring->maxElems - (size_t)(tailSeq % ring->maxElems)) % ring->maxElems;
+	retval->claimSeq = tailSeq;
+	retval->releasedSeq = tailSeq;
+	retval->advancing = 0;
+	retval->releaseFn = NULL;
+	retval->releaseArg = NULL;
+	CB_DEBUG_Print("CB:\tBatch consumer initialised. Consumer pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularBatchDelete(CBBatchConsumer_t *consumer)
+{
+	if (consumer == NULL)
+		return CB_error;
+	emCircularPortFree(consumer->done);
+	emCircularPortFree(consumer);
+	return CB_true;
+}
+
+size_t emCircularBatchClaim(CBBatchConsumer_t *consumer, CBBatch_t *batch)
+{
+	return emCircularBatchClaimLimit(consumer, batch, UINT64_MAX);
+}
+
+size_t emCircularBatchClaimLimit(CBBatchConsumer_t *consumer, CBBatch_t *batch, const uint64_t limitSeq)
+{
+	if ((consumer == NULL) || (batch == NULL))
+		return 0;
+	size_t retval;
+	uint64_t seq = emCircularPort_AtomicLoad(&consumer->claimSeq);
+	do
+	{
+		/* releasedSeq is read before the number of elements: the tail is moved
+		 * before releasedSeq, so the available elements are never overestimated */
+		uint64_t released = emCircularPort_AtomicLoad(&consumer->releasedSeq);
+		uint64_t headSeq = released + emCircularPort_AtomicLoad(&consumer->ring->NbElems);
+		if (headSeq > limitSeq)
+		{
+			headSeq = limitSeq;
+		}
+		if (headSeq <= seq)
+			return 0;
+		retval = (size_t)(headSeq - seq);
+		if (retval > consumer->batchElems)
+		{
+			retval = consumer->batchElems;
+		}
+		size_t index = emCircularBatchIndex(consumer, seq);
+		if (retval > (consumer->ring->maxElems - index))
+		{
+			retval = consumer->ring->maxElems - index;
+		}
+	} while (!emCircularPort_AtomicCAS(&consumer->claimSeq, &seq, seq + retval));
+	batch->seq = seq;
+	batch->elems = consumer->ring->startBuffer + (emCircularBatchIndex(consumer, seq) * consumer->ring->elemSize);
+	batch->nbElems = retval;
+	return retval;
+}
+
+CBStatus_t emCircularBatchSetRelease(CBBatchConsumer_t *consumer, CBBatchReleaseFn_t releaseFn, void *arg)
+{
+	if (consumer == NULL)
+		return CB_error;
+	consumer->releaseFn = releaseFn;
+	consumer->releaseArg = arg;
+	return CB_true;
+}
+
+CBStatus_t emCircularBatchDone(CBBatchConsumer_t *consumer, const CBBatch_t *batch)
+{
+	if ((consumer == NULL) || (batch == NULL) || (batch->nbElems < 1))
+		return CB_error;
+	emCircularPort_AtomicStore(&consumer->done[emCircularBatchIndex(consumer, batch->seq)], batch->nbElems);
+	/* A batch marked while another consumer is advancing is seen by its last check */
+	emCircularPort_AtomicFence();
+	for (;;)
+	{
+		int expected = 0;
+		if (!emCircularPort_AtomicCAS(&consumer->advancing, &expected, 1))
+			break;
+		emCircularBatchAdvance(consumer);
+		emCircularPort_AtomicStore(&consumer->advancing, 0);
+		emCircularPort_AtomicFence();
+		uint64_t released = emCircularPort_AtomicLoad(&consumer->releasedSeq);
+		if (emCircularPort_AtomicLoad(&consumer->done[emCircularBatchIndex(consumer, released)]) == 0)
+			break;
+	}
+	return CB_true;
+}
@@ -0,0 +1,139 @@
+/*
+ * @file emCircularBatch.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements parallel consumers of a circular buffer that
+ * claim disjoint batches of elements.
+ *
+ * Every consumer claims a batch of contiguous elements with a single atomic
+ * operation and processes it in place. The elements stay in the buffer until all
+ * the earlier batches are done too: the consumer that completes a batch marks it
+ * in a table of done flags, and one consumer at a time moves the tail of the buffer
+ * over all the batches done in order. So the producer never overwrites an element
+ * being processed and the buffer is locked once per batch instead of once per element.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARBATCH_H_
+#define EMCIRCULARBATCH_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of a batch claimed by a consumer
+ */
+typedef struct CBBatch_t
+{
+	uint64_t seq;		// sequence number of the first element of the batch
+	void *elems;		// pointer to the first element, the elements are contiguous
+	size_t nbElems;		// number of elements of the batch
+} CBBatch_t;
+
+struct CBBatchConsumer_t;
+
+/*
+ * Definition of the function called, in order, on the elements of the batches
+ * done just before they are removed from the buffer
+ */
+typedef void (*CBBatchReleaseFn_t)(struct CBBatchConsumer_t *consumer, uint64_t seq, size_t nbElems, void *arg);
+
+/*
+ * Definition of the batch consumer data type
+ */
+typedef struct CBBatchConsumer_t
+{
+	CBuffer_t *ring;		// buffer consumed
+	size_t batchElems;		// maximum number of elements of a batch
+	size_t base;			// index of the sequence number 0 in the buffer, modulo maxElems
+	uint64_t claimSeq;		// sequence number of the next element to be claimed
+	uint64_t releasedSeq;	// sequence number of the tail of the buffer
+	size_t *done;			// for every index, size of the batch starting there once it is done
+	int advancing;			// set while a consumer is moving the tail of the buffer
+	CBBatchReleaseFn_t releaseFn; // function called before the elements are removed, can be NULL
+	void *releaseArg;		// user argument of the release function
+} CBBatchConsumer_t;
+
+/*
+ * @brief This function initializes the batch consumer. From this point the
+ * 		tail of the buffer must be moved only by the batch consumer.
+ *
+ * @param ring, pointer to the circular buffer to be consumed
+ * @param batchElems, maximum number of elements claimed at once
+ * @return CBBatchConsumer_t*, pointer to the batch consumer created. Returns
+ * 		NULL if it was not possible to create the batch consumer
+ */
+CBBatchConsumer_t *emCircularBatchInit(CBuffer_t *ring, const size_t batchElems);
+
+/*
+ * @brief This function deletes the batch consumer. The buffer is not deleted.
+ *
+ * @param consumer, pointer to the batch consumer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularBatchDelete(CBBatchConsumer_t *consumer);
+
+/*
+ * @brief This function claims up to batchElems elements. A batch never
+ * 		wraps at the end of the buffer memory, so it can be smaller.
+ * 		Many threads can claim at the same time.
+ *
+ * @param consumer, pointer to the batch consumer to be used
+ * @param batch, filled with the batch claimed
+ * @return size_t, number of elements claimed. Returns 0 if there are
+ * 		no elements to be claimed
+ */
+size_t emCircularBatchClaim(CBBatchConsumer_t *consumer, CBBatch_t *batch);
+
+/*
+ * @brief This function works like emCircularBatchClaim() but only claims
+ * 		elements with a sequence number lower than limitSeq, e.g. to bound
+ * 		the elements in progress to the free space of a next stage.
+ *
+ * @param consumer, pointer to the batch consumer to be used
+ * @param batch, filled with the batch claimed
+ * @param limitSeq, sequence number of the first element that cannot be claimed
+ * @return size_t, number of elements claimed. Returns 0 if there are
+ * 		no elements to be claimed
+ */
+size_t emCircularBatchClaimLimit(CBBatchConsumer_t *consumer, CBBatch_t *batch, const uint64_t limitSeq);
+
+/*
+ * @brief This function configures the function called on the batches done,
+ * 		in order of sequence number and by one consumer at a time, before
+ * 		their elements are removed from the buffer.
+ * 		It must be called before the consumers start.
+ *
+ * @param consumer, pointer to the batch consumer to be configured
+ * @param releaseFn, function to be called. Can be NULL
+ * @param arg, user argument passed to releaseFn
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularBatchSetRelease(CBBatchConsumer_t *consumer, CBBatchReleaseFn_t releaseFn, void *arg);
+
+/*
+ * @brief This function marks a batch as done. The elements are removed from
+ * 		the buffer when all the batches claimed before are done too.
+ *
+ * @param consumer, pointer to the batch consumer to be used
+ * @param batch, batch returned by emCircularBatchClaim()
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularBatchDone(CBBatchConsumer_t *consumer, const CBBatch_t *batch);
+
+#endif /* EMCIRCULARBATCH_H_ */
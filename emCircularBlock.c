@@ -0,0 +1,138 @@
+/*
+ * @file emCircularBlock.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "emCircularBlock.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the pointer to the block of a block counter
+ */
+static void *emCircularBlockPtr(const CBBlocks_t *blocks, const uint64_t count)
+{
+	return blocks->startBuffer + ((size_t)(count % blocks->nbBlocks) * blocks->blockSize);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBBlocks_t *emCircularBlockInit(const size_t nbBlocks, const size_t blockSize)
+{
+	if ((nbBlocks < 2) || (blockSize < 1))
+		return NULL;
+	CBBlocks_t *retval = (CBBlocks_t *)emCircularPortMalloc(sizeof(CBBlocks_t));
+	if (retval == NULL)
+		return NULL;
+	retval->startBuffer = (unsigned char *)emCircularPortMalloc(nbBlocks * blockSize);
+	retval->sizes = (size_t *)emCircularPortMalloc(nbBlocks * sizeof(size_t));
+	if ((retval->startBuffer == NULL) || (retval->sizes == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the blocks!\r\n");
+		emCircularBlockDelete(retval);
+		return NULL;
+	}
+	retval->blockSize = blockSize;
+	retval->nbBlocks = nbBlocks;
+	retval->headCount = 0;
+	retval->tailCount = 0;
+	CB_DEBUG_Print("CB:\tBlock buffer initialised. Buffer pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularBlockDelete(CBBlocks_t *blocks)
+{
+	if (blocks == NULL)
+		return CB_error;
+	if (blocks->startBuffer != NULL)
+		emCircularPortFree(blocks->startBuffer);
+	if (blocks->sizes != NULL)
+		emCircularPortFree(blocks->sizes);
+	emCircularPortFree(blocks);
+	return CB_true;
+}
+
+void *emCircularBlockAcquireHead(CBBlocks_t *blocks)
+{
+	if (blocks == NULL)
+		return NULL;
+	uint64_t head = blocks->headCount;
+	if ((head - emCircularPort_AtomicLoad(&blocks->tailCount)) >= blocks->nbBlocks)
+	{
+		CB_DEBUG_Print("CB:\tAll the blocks are full.\r\n");
+		return NULL;
+	}
+	return emCircularBlockPtr(blocks, head);
+}
+
+CBStatus_t emCircularBlockReleaseHead(CBBlocks_t *blocks, const size_t size)
+{
+	if ((blocks == NULL) || (size > blocks->blockSize))
+		return CB_error;
+	uint64_t head = blocks->headCount;
+	if ((head - emCircularPort_AtomicLoad(&blocks->tailCount)) >= blocks->nbBlocks)
+		return CB_false;
+	blocks->sizes[head % blocks->nbBlocks] = size;
+	emCircularPort_AtomicStore(&blocks->headCount, head + 1);
+	return CB_true;
+}
+
+void *emCircularBlockAcquireTail(CBBlocks_t *blocks, size_t *size)
+{
+	if (blocks == NULL)
+		return NULL;
+	uint64_t tail = blocks->tailCount;
+	if (emCircularPort_AtomicLoad(&blocks->headCount) == tail)
+		return NULL;
+	if (size != NULL)
+	{
+		*size = blocks->sizes[tail % blocks->nbBlocks];
+	}
+	return emCircularBlockPtr(blocks, tail);
+}
+
+CBStatus_t emCircularBlockReleaseTail(CBBlocks_t *blocks)
+{
+	if (blocks == NULL)
+		return CB_error;
+	uint64_t tail = blocks->tailCount;
+	if (emCircularPort_AtomicLoad(&blocks->headCount) == tail)
+		return CB_false;
+	emCircularPort_AtomicStore(&blocks->tailCount, tail + 1);
+	return CB_true;
+}
+
+size_t emCircularBlockGetNbFull(const CBBlocks_t *blocks)
+{
+	if (blocks == NULL)
+		return 0;
+	uint64_t tail = emCircularPort_AtomicLoad(&blocks->tailCount);
+	return (size_t)(emCircularPort_AtomicLoad(&blocks->headCount) - tail);
+}
@@ -0,0 +1,114 @@
+/*
+ * @file emCircularBlock.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a circular buffer of K fixed-size blocks
+ * exchanged whole between one producer and one consumer.
+ *
+ * The producer acquires a free block, fills it (e.g. with a DMA transfer) and
+ * releases it; the consumer acquires the oldest full block, processes it in place
+ * and releases it. Every acquire and release costs a single atomic operation, so
+ * there is no per-element overhead, and all the K blocks can be full at the same
+ * time. K = 2 is the classic ping-pong buffer.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARBLOCK_H_
+#define EMCIRCULARBLOCK_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the block buffer data type
+ */
+typedef struct CBBlocks_t
+{
+	unsigned char *startBuffer; // memory of the blocks
+	size_t blockSize;			// size in bytes of a block
+	size_t nbBlocks;			// number of blocks
+	size_t *sizes;				// number of bytes used in every full block
+	uint64_t headCount;			// number of blocks released by the producer
+	uint64_t tailCount;			// number of blocks released by the consumer
+} CBBlocks_t;
+
+/*
+ * @brief This function initializes the block buffer allocating the memory of the blocks.
+ *
+ * @param nbBlocks, number of blocks. Must be at least 2
+ * @param blockSize, size of every block in terms of bytes
+ * @return CBBlocks_t*, pointer to the block buffer created. Returns
+ * 		NULL if it was not possible to create the block buffer
+ */
+CBBlocks_t *emCircularBlockInit(const size_t nbBlocks, const size_t blockSize);
+
+/*
+ * @brief This function deletes the block buffer and frees its memory.
+ *
+ * @param blocks, pointer to the block buffer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularBlockDelete(CBBlocks_t *blocks);
+
+/*
+ * @brief This function returns the block to be filled by the producer.
+ * 		Until it is released the same block is returned.
+ *
+ * @param blocks, pointer to the block buffer to be used
+ * @return void*, pointer to the free block. Returns NULL if all the blocks are full
+ */
+void *emCircularBlockAcquireHead(CBBlocks_t *blocks);
+
+/*
+ * @brief This function publishes the block acquired by the producer.
+ *
+ * @param blocks, pointer to the block buffer to be used
+ * @param size, number of bytes written in the block, not greater than the block size
+ * @return CBStatus_t, return value. Returns CB_true if the block was released,
+ * 		CB_false if there was no free block
+ */
+CBStatus_t emCircularBlockReleaseHead(CBBlocks_t *blocks, const size_t size);
+
+/*
+ * @brief This function returns the oldest full block to the consumer.
+ * 		Until it is released the same block is returned.
+ *
+ * @param blocks, pointer to the block buffer to be used
+ * @param size, pointer where the number of bytes used in the block is stored. Can be NULL
+ * @return void*, pointer to the full block. Returns NULL if all the blocks are free
+ */
+void *emCircularBlockAcquireTail(CBBlocks_t *blocks, size_t *size);
+
+/*
+ * @brief This function gives back to the producer the block acquired by the consumer.
+ *
+ * @param blocks, pointer to the block buffer to be used
+ * @return CBStatus_t, return value. Returns CB_true if the block was released,
+ * 		CB_false if there was no full block
+ */
+CBStatus_t emCircularBlockReleaseTail(CBBlocks_t *blocks);
+
+/*
+ * @brief This function returns the number of full blocks.
+ *
+ * @param blocks, pointer to the block buffer to be checked
+ * @return size_t, number of full blocks
+ */
+size_t emCircularBlockGetNbFull(const CBBlocks_t *blocks);
+
+#endif /* EMCIRCULARBLOCK_H_ */
@@ -19,6 +19,7 @@
  * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
  * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+#include <string.h>
 #include "emCircularBuffer.h"
 #include "emCircularPort.h"
 
@@ -32,6 +33,269 @@
 #define CB_DEBUG_Print(...)
 #endif
 
+/*
+ * Updates the watermark state after a change of the number of elements
+ * and returns the event to be notified. Must be called inside the critical section.
+ */
+static CBEvent_t emCircularCheckWatermarkUnlocked(CBuffer_t *buffer)
+{
+	if (buffer->highWatermark == 0)
+		return CB_EventNone;
+	if ((buffer->aboveWatermark == CB_false) && (emCircularPort_AtomicLoad(&buffer->NbElems) >= buffer->highWatermark))
+	{
+		buffer->aboveWatermark = CB_true;
+		return CB_EventHighWatermark;
+	}
+	if ((buffer->aboveWatermark == CB_true) && (emCircularPort_AtomicLoad(&buffer->NbElems) <= buffer->lowWatermark))
+	{
+		buffer->aboveWatermark = CB_false;
+		return CB_EventLowWatermark;
+	}
+	return CB_EventNone;
+}
+
+/*
+ * Notifies the watermark event returned by emCircularCheckWatermarkUnlocked().
+ * Must be called outside of the critical section.
+ */
+static void emCircularNotifyWatermark(CBuffer_t *buffer, const CBEvent_t event)
+{
+	if ((event != CB_EventNone) && (buffer->watermarkCb != NULL))
+	{
+		buffer->watermarkCb(buffer, event, buffer->watermarkArg);
+	}
+}
+
+/*
+ * Notifies a push or pop event to the notify callback, if configured.
+ * Must be called outside of the critical section.
+ */
+static void emCircularNotify(CBuffer_t *buffer, const CBEvent_t event)
+{
+	CBEventCallback_t callback = emCircularPort_AtomicLoad(&buffer->notifyCb);
+	if (callback != NULL)
+	{
+		callback(buffer, event, emCircularPort_AtomicLoad(&buffer->notifyArg));
+	}
+}
+
+#if CIRCULAR_USE_RATE_LIMIT
+/*
+ * Refills a token bucket with the tokens earned in the elapsed ticks
+ */
+static uint64_t emCircularRefillBucket(uint64_t tokens, const uint64_t bucket, const uint32_t rate, const uint32_t elapsed)
+{
+	uint64_t missing = bucket - tokens;
+	if (elapsed > (missing / rate))
+	{
+		return bucket;
+	}
+	return tokens + ((uint64_t)elapsed * rate);
+}
+
+/*
+ * Takes the tokens for one element from the buckets of the rate limiter.
+ * Must be called inside the critical section.
+ */
+static CBStatus_t emCircularTakeTokensUnlocked(CBuffer_t *buffer)
+{
+	if ((buffer->rateElems == 0) && (buffer->rateBytes == 0))
+		return CB_true;
+	uint32_t now = emCircularPort_GetTick();
+	uint32_t elapsed = now - buffer->lastTick;
+	uint64_t freq = emCircularPort_GetTickFreq();
+	uint64_t costBytes = (uint64_t)buffer->elemSize * freq;
+	buffer->lastTick = now;
+	if (buffer->rateElems != 0)
+	{
+		buffer->tokensElems = emCircularRefillBucket(buffer->tokensElems, buffer->bucketElems, buffer->rateElems, elapsed);
+		if (buffer->tokensElems < freq)
+			return CB_false;
+	}
+	if (buffer->rateBytes != 0)
+	{
+		buffer->tokensBytes = emCircularRefillBucket(buffer->tokensBytes, buffer->bucketBytes, buffer->rateBytes, elapsed);
+		if (buffer->tokensBytes < costBytes)
+			return CB_false;
+		buffer->tokensBytes -= costBytes;
+	}
+	if (buffer->rateElems != 0)
+	{
+		buffer->tokensElems -= freq;
+	}
+	return CB_true;
+}
+#endif
+
+/*
+ * Returns how many of nbElems elements can be pushed now, taking their tokens
+ * from the rate limiter if enabled. Must be called inside the critical section.
+ */
+static size_t emCircularTakeTokensBatchUnlocked(CBuffer_t *buffer, const size_t nbElems)
+{
+#if CIRCULAR_USE_RATE_LIMIT
+	size_t retval = 0;
+	while ((retval < nbElems) && (emCircularTakeTokensUnlocked(buffer) == CB_true))
+	{
+		retval++;
+	}
+	if (retval < nbElems)
+	{
+		CB_DEBUG_Print("CB:\tBuffer is rate limited.\r\n");
+	}
+	return retval;
+#else
+	(void)buffer;
+	return nbElems;
+#endif
+}
+
+/*
+ * Gives back to the rate limiter the tokens of nbElems elements that were
+ * allowed but not pushed, e.g. because the buffer is full.
+ * Must be called inside the critical section.
+ */
+static void emCircularRefundTokensUnlocked(CBuffer_t *buffer, const size_t nbElems)
+{
+#if CIRCULAR_USE_RATE_LIMIT
+	uint64_t freq = emCircularPort_GetTickFreq();
+	if (buffer->rateElems != 0)
+	{
+		buffer->tokensElems += (uint64_t)nbElems * freq;
+		if (buffer->tokensElems > buffer->bucketElems)
+		{
+			buffer->tokensElems = buffer->bucketElems;
+		}
+	}
+	if (buffer->rateBytes != 0)
+	{
+		buffer->tokensBytes += (uint64_t)nbElems * buffer->elemSize * freq;
+		if (buffer->tokensBytes > buffer->bucketBytes)
+		{
+			buffer->tokensBytes = buffer->bucketBytes;
+		}
+	}
+#else
+	(void)buffer;
+	(void)nbElems;
+#endif
+}
+
+/*
+ * Moves the tail of the buffer back by nbElems elements retained in the history.
+ * Must be called inside the critical section.
+ */
+static void emCircularRewindUnlocked(CBuffer_t *buffer, const size_t nbElems)
+{
+	buffer->tailInd = (buffer->tailInd + buffer->maxElems - (nbElems % buffer->maxElems)) % buffer->maxElems;
+	emCircularPort_AtomicStore(&buffer->tailSeq, buffer->tailSeq - nbElems);
+	emCircularPort_AtomicFetchAdd(&buffer->rewinds, 1);
+	emCircularPort_AtomicFetchAdd(&buffer->NbReserved, nbElems);
+	emCircularPort_AtomicFetchAdd(&buffer->NbElems, nbElems);
+	emCircularPort_AtomicStore(&buffer->NbHistory, buffer->NbHistory - nbElems);
+}
+
+/*
+ * Moves the tail of the buffer forward by nbElems elements, moving them
+ * in the history. Must be called inside the critical section.
+ */
+static void emCircularConsumeUnlocked(CBuffer_t *buffer, const size_t nbElems)
+{
+	size_t history = buffer->NbHistory + nbElems;
+	if (history > buffer->historyElems)
+	{
+		history = buffer->historyElems;
+	}
+	buffer->tailInd = (buffer->tailInd + nbElems) % buffer->maxElems;
+	/* The tail is moved before the slots are freed: a reader that copies an element
+	 * and then finds it still behind the tail knows that the copy is not torn */
+	emCircularPort_AtomicStore(&buffer->tailSeq, buffer->tailSeq + nbElems);
+	emCircularPort_AtomicStore(&buffer->NbHistory, history);
+	emCircularPort_AtomicFetchSub(&buffer->NbElems, nbElems);
+	emCircularPort_AtomicFetchSub(&buffer->NbReserved, nbElems);
+	/* In overwrite mode the caller writes the freed slots next, after the new tail */
+	emCircularPort_AtomicFence();
+}
+
+/*
+ * Reserves up to nbElems consecutive slots for a producer, stores the index of
+ * the first one in index and returns how many were reserved. The free space is
+ * checked against the reserved elements, that are released by the consumer only
+ * after the history is updated, so a producer never takes a slot still in use.
+ * Only atomic operations are used, so a producer interrupted inside this function
+ * by a signal handler pushing in the same buffer just retries.
+ */
+static size_t emCircularReserveSlots(CBuffer_t *buffer, const size_t nbElems, size_t *index)
+{
+	size_t retval;
+	size_t reserved = emCircularPort_AtomicLoad(&buffer->NbReserved);
+	do
+	{
+		size_t used = reserved + emCircularPort_AtomicLoad(&buffer->NbHistory) + 1;
+		if (used >= buffer->maxElems)
+			return 0;
+		retval = buffer->maxElems - used;
+		if (retval > nbElems)
+		{
+			retval = nbElems;
+		}
+	} while (!emCircularPort_AtomicCAS(&buffer->NbReserved, &reserved, reserved + retval));
+
+	*index = emCircularPort_AtomicLoad(&buffer->headInd);
+	while (!emCircularPort_AtomicCAS(&buffer->headInd, index, (*index + retval) % buffer->maxElems))
+	{
+	}
+	return retval;
+}
+
+/*
+ * Marks nbElems slots from index as written and publishes to the consumer the
+ * written slots that follow the last one published, in order, so a slot is never
+ * visible while a previous one is still being written. Only one producer at a time
+ * publishes: a producer that commits while another one is publishing just counts
+ * a request, that the publisher sees before leaving. A signal handler nesting in
+ * a producer therefore never waits, the interrupted producer publishes its slot.
+ */
+static void emCircularCommitSlots(CBuffer_t *buffer, size_t index, const size_t nbElems)
+{
+	for (size_t i = 0; i < nbElems; i++)
+	{
+		emCircularPort_AtomicStore(&buffer->committed[index], 1);
+		index = (index + 1) % buffer->maxElems;
+	}
+	if (emCircularPort_AtomicFetchAdd(&buffer->publishRequests, 1) != 0)
+		return;
+	size_t requests = 1;
+	for (;;)
+	{
+		size_t pub = emCircularPort_AtomicLoad(&buffer->publishInd);
+		while (emCircularPort_AtomicLoad(&buffer->committed[pub]) != 0)
+		{
+			/* The flag is cleared before the slot can be consumed and reserved again */
+			emCircularPort_AtomicStore(&buffer->committed[pub], 0);
+			pub = (pub + 1) % buffer->maxElems;
+			emCircularPort_AtomicStore(&buffer->publishInd, pub);
+			emCircularPort_AtomicFetchAdd(&buffer->NbElems, 1);
+		}
+		size_t expected = requests;
+		if (emCircularPort_AtomicCAS(&buffer->publishRequests, &expected, 0))
+			break;
+		requests = expected;
+	}
+}
+
+/*
+ * Reserves one slot for a producer and returns its index, or maxElems if the
+ * buffer is full
+ */
+static size_t emCircularReserveSlot(CBuffer_t *buffer)
+{
+	size_t index = buffer->maxElems;
+	if (emCircularReserveSlots(buffer, 1, &index) == 0)
+		return buffer->maxElems;
+	return index;
+}
+
 /*
  * PUBLIC FUNCTIONS
  */
@@ -44,12 +308,38 @@ CBuffer_t *emCircularInit(const size_t maxElems, const size_t elemSize, const ch
 		return NULL;
 	CBuffer_t *retval = (CBuffer_t *)emCircularPortMalloc(sizeof(CBuffer_t));
 	unsigned char *buffer = (unsigned char *)emCircularPortMalloc(maxElems * elemSize);
+	unsigned char *committed = (unsigned char *)emCircularPortMalloc(maxElems);
+	if (committed != NULL)
+	{
+		memset(committed, 0, maxElems);
+	}
 	retval->headInd = 0;
 	retval->tailInd = 0;
 	retval->startBuffer = buffer;
 	retval->elemSize = elemSize;
 	retval->maxElems = maxElems;
 	retval->NbElems = 0;
+	retval->NbReserved = 0;
+	retval->committed = committed;
+	retval->publishInd = 0;
+	retval->publishRequests = 0;
+	retval->tailSeq = 0;
+	retval->pendingSeq = UINT64_MAX;
+	retval->rewinds = 0;
+	retval->historyElems = 0;
+	retval->NbHistory = 0;
+	retval->highWatermark = 0;
+	retval->lowWatermark = 0;
+	retval->watermarkCb = NULL;
+	retval->watermarkArg = NULL;
+	retval->aboveWatermark = CB_false;
+	retval->notifyCb = NULL;
+	retval->notifyArg = NULL;
+	retval->overwrite = CB_false;
+#if CIRCULAR_USE_RATE_LIMIT
+	retval->rateElems = 0;
+	retval->rateBytes = 0;
+#endif
 	retval->sem = emCircularPort_InitBynSem(sem_name);
 #if CIRCULAR_USE_LOCK_MECHANISM
 	if (retval->sem == NULL)
@@ -81,6 +371,10 @@ CBStatus_t emCircularDelete(CBuffer_t *buffer)
 	{
 		emCircularPortFree(buffer->startBuffer);
 	}
+	if (buffer->committed != NULL)
+	{
+		emCircularPortFree(buffer->committed);
+	}
 	if (buffer == NULL)
 	{
 		retval = CB_true;
@@ -109,7 +403,7 @@ CBStatus_t emCircularIsEmpty(const CBuffer_t *buffer)
 	}
 	else
 	{
-		if (buffer->headInd == buffer->tailInd)
+		if (emCircularPort_AtomicLoad(&buffer->NbElems) == 0)
 		{
 			retval = CB_true;
 		}
@@ -133,7 +427,7 @@ CBStatus_t emCircularIsFull(const CBuffer_t *buffer)
 	}
 	else
 	{
-		if (((buffer->headInd + 1) % buffer->maxElems) == buffer->tailInd)
+		if ((emCircularPort_AtomicLoad(&buffer->NbReserved) + emCircularPort_AtomicLoad(&buffer->NbHistory) + 1) >= buffer->maxElems)
 		{
 			retval = CB_true;
 		}
@@ -153,21 +447,35 @@ size_t emCircularGetRemainingSpace(const CBuffer_t *buffer)
 		return 0;
 	}
 	size_t retval = 0;
-	if (buffer->maxElems >= buffer->NbElems)
+	size_t reserved = emCircularPort_AtomicLoad(&buffer->NbReserved);
+	size_t history = emCircularPort_AtomicLoad(&buffer->NbHistory);
+	if (buffer->maxElems >= (reserved + history))
 	{
-		retval = buffer->maxElems - buffer->NbElems;
+		retval = buffer->maxElems - reserved - history;
 	}
 	emCircularPort_ExitCritical(buffer->sem);
 	return retval;
 }
 
 void *emCircularGetHead(CBuffer_t *buffer)
+{
+	return emCircularGetHeadWithSeq(buffer, NULL);
+}
+
+void *emCircularGetTail(CBuffer_t *buffer)
+{
+	return emCircularGetTailWithSeq(buffer, NULL);
+}
+
+void *emCircularGetHeadWithSeq(CBuffer_t *buffer, uint64_t *seq)
 {
 	if (buffer == NULL)
 		return NULL;
 	switch (emCircularIsFull(buffer))
 	{
 	case CB_true:
+		if (buffer->overwrite == CB_true)
+			break;
 		CB_DEBUG_Print("CB:\tBuffer is full.\r\n");
 		return NULL;
 	case CB_error:
@@ -185,23 +493,194 @@ void *emCircularGetHead(CBuffer_t *buffer)
 		emCircularPort_ExitCritical(buffer->sem);
 		return NULL;
 	}
-	void *retval = (unsigned char *)buffer->startBuffer + (buffer->headInd * buffer->elemSize);
+#if CIRCULAR_USE_RATE_LIMIT
+	if (emCircularTakeTokensUnlocked(buffer) != CB_true)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tBuffer is rate limited.\r\n");
+		return NULL;
+	}
+#endif
+	size_t index = emCircularReserveSlot(buffer);
+	while ((index == buffer->maxElems) && (buffer->overwrite == CB_true) &&
+		   (emCircularPort_AtomicLoad(&buffer->NbElems) > 0))
+	{
+		CB_DEBUG_Print("CB:\tBuffer is full, tail element overwritten.\r\n");
+		emCircularConsumeUnlocked(buffer, 1);
+		index = emCircularReserveSlot(buffer);
+	}
+	if (index == buffer->maxElems)
+	{
+		emCircularRefundTokensUnlocked(buffer, 1);
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tBuffer is full.\r\n");
+		return NULL;
+	}
+	void *retval = (unsigned char *)buffer->startBuffer + (index * buffer->elemSize);
 
 	CB_DEBUG_Print("CB:\tBuffer Head pointer is %p.\r\n", retval);
 
-	buffer->headInd = (buffer->headInd + 1) % buffer->maxElems;
-	buffer->NbElems++;
+	/* The element is published before the caller writes it */
+	uint64_t headSeq = buffer->tailSeq + ((index + buffer->maxElems - buffer->tailInd) % buffer->maxElems);
+	emCircularPort_AtomicStore(&buffer->pendingSeq, headSeq);
+	if (seq != NULL)
+	{
+		*seq = headSeq;
+	}
 
-	if (buffer->NbElems > buffer->maxElems)
+	emCircularCommitSlots(buffer, index, 1);
+	if (emCircularPort_AtomicLoad(&buffer->NbElems) > buffer->maxElems)
 	{
 		CB_DEBUG_Print("Error!! Number of elements greater than max number of elements!\r\n");
 		retval = NULL;
 	}
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
 	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPush);
 	return retval;
 }
 
-void *emCircularGetTail(CBuffer_t *buffer)
+size_t emCircularGetHeadBatch(CBuffer_t *buffer, const size_t nbElems, CBSpan_t *span)
+{
+	if ((buffer == NULL) || (span == NULL))
+		return 0;
+	span->first = NULL;
+	span->firstNbElems = 0;
+	span->second = NULL;
+	span->secondNbElems = 0;
+	if (nbElems < 1)
+		return 0;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return 0;
+	}
+	size_t allowed = emCircularTakeTokensBatchUnlocked(buffer, nbElems);
+	if (allowed == 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return 0;
+	}
+	size_t index = 0;
+	size_t retval = emCircularReserveSlots(buffer, allowed, &index);
+	emCircularRefundTokensUnlocked(buffer, allowed - retval);
+	if (retval == 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tBuffer is full.\r\n");
+		return 0;
+	}
+	span->first = buffer->startBuffer + (index * buffer->elemSize);
+	span->firstNbElems = retval;
+	if ((index + retval) > buffer->maxElems)
+	{
+		span->firstNbElems = buffer->maxElems - index;
+		span->second = buffer->startBuffer;
+		span->secondNbElems = retval - span->firstNbElems;
+	}
+	/* The elements are published before the caller writes them */
+	emCircularPort_AtomicStore(&buffer->pendingSeq,
+							   buffer->tailSeq + ((index + buffer->maxElems - buffer->tailInd) % buffer->maxElems));
+	emCircularCommitSlots(buffer, index, retval);
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPush);
+	return retval;
+}
+
+size_t emCircularReserveHeadBatch(CBuffer_t *buffer, const size_t nbElems, CBSpan_t *span)
+{
+	if ((buffer == NULL) || (span == NULL))
+		return 0;
+	span->first = NULL;
+	span->firstNbElems = 0;
+	span->second = NULL;
+	span->secondNbElems = 0;
+	if (nbElems < 1)
+		return 0;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return 0;
+	}
+	size_t allowed = emCircularTakeTokensBatchUnlocked(buffer, nbElems);
+	if (allowed == 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return 0;
+	}
+	size_t dropped = 0;
+	if (buffer->overwrite == CB_true)
+	{
+		size_t used = emCircularPort_AtomicLoad(&buffer->NbReserved) + emCircularPort_AtomicLoad(&buffer->NbHistory) + 1;
+		size_t space = (buffer->maxElems > used) ? (buffer->maxElems - used) : 0;
+		if (space < allowed)
+		{
+			dropped = allowed - space;
+			if (dropped > emCircularPort_AtomicLoad(&buffer->NbElems))
+			{
+				dropped = emCircularPort_AtomicLoad(&buffer->NbElems);
+			}
+			CB_DEBUG_Print("CB:\tBuffer is full, tail elements overwritten.\r\n");
+			emCircularConsumeUnlocked(buffer, dropped);
+		}
+	}
+	size_t index = 0;
+	size_t retval = emCircularReserveSlots(buffer, allowed, &index);
+	emCircularRefundTokensUnlocked(buffer, allowed - retval);
+	if (retval > 0)
+	{
+		span->first = buffer->startBuffer + (index * buffer->elemSize);
+		span->firstNbElems = retval;
+		if ((index + retval) > buffer->maxElems)
+		{
+			span->firstNbElems = buffer->maxElems - index;
+			span->second = buffer->startBuffer;
+			span->secondNbElems = retval - span->firstNbElems;
+		}
+	}
+	else
+	{
+		CB_DEBUG_Print("CB:\tBuffer is full.\r\n");
+	}
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	if (dropped > 0)
+	{
+		emCircularNotify(buffer, CB_EventPop);
+	}
+	return retval;
+}
+
+CBStatus_t emCircularCommitHeadBatch(CBuffer_t *buffer, const CBSpan_t *span)
+{
+	if ((buffer == NULL) || (span == NULL))
+		return CB_error;
+	size_t nbElems = span->firstNbElems + span->secondNbElems;
+	if (nbElems < 1)
+		return CB_false;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	size_t index = (size_t)((unsigned char *)span->first - buffer->startBuffer) / buffer->elemSize;
+	emCircularPort_AtomicStore(&buffer->pendingSeq, UINT64_MAX);
+	emCircularCommitSlots(buffer, index, nbElems);
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPush);
+	return CB_true;
+}
+
+void *emCircularGetTailWithSeq(CBuffer_t *buffer, uint64_t *seq)
 {
 	if (buffer == NULL)
 		return NULL;
@@ -229,14 +708,468 @@ void *emCircularGetTail(CBuffer_t *buffer)
 
 	CB_DEBUG_Print("CB:\tBuffer Tail pointer is %p.\r\n", retval);
 
-	buffer->tailInd = (buffer->tailInd + 1) % buffer->maxElems;
-	buffer->NbElems--;
+	if (seq != NULL)
+	{
+		*seq = buffer->tailSeq;
+	}
+	emCircularConsumeUnlocked(buffer, 1);
 
 	if (buffer->NbElems < 0)
 	{
 		CB_DEBUG_Print("Error!! No elements in the buffer!\r\n");
 		retval = NULL;
 	}
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPop);
+	return retval;
+}
+
+void *emCircularPeekTail(const CBuffer_t *buffer, uint64_t *seq)
+{
+	if (buffer == NULL)
+		return NULL;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return NULL;
+	}
+	void *retval = NULL;
+	if (emCircularPort_AtomicLoad(&buffer->NbElems) > 0)
+	{
+		retval = buffer->startBuffer + (buffer->tailInd * buffer->elemSize);
+		if (seq != NULL)
+		{
+			*seq = buffer->tailSeq;
+		}
+	}
+	emCircularPort_ExitCritical(buffer->sem);
+	return retval;
+}
+
+void *emCircularPeekSeq(const CBuffer_t *buffer, uint64_t seq)
+{
+	if (buffer == NULL)
+		return NULL;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return NULL;
+	}
+	void *retval = NULL;
+	uint64_t oldestSeq = buffer->tailSeq - buffer->NbHistory;
+	if ((seq >= oldestSeq) && ((seq - oldestSeq) < (buffer->NbHistory + emCircularPort_AtomicLoad(&buffer->NbElems))))
+	{
+		size_t oldestInd = (buffer->tailInd + buffer->maxElems - buffer->NbHistory) % buffer->maxElems;
+		size_t index = (oldestInd + (size_t)(seq - oldestSeq)) % buffer->maxElems;
+		retval = buffer->startBuffer + (index * buffer->elemSize);
+	}
+	else
+	{
+		CB_DEBUG_Print("CB:\tSequence number is not in the buffer.\r\n");
+	}
+	emCircularPort_ExitCritical(buffer->sem);
+	return retval;
+}
+
+uint64_t emCircularGetHeadSeq(const CBuffer_t *buffer)
+{
+	if (buffer == NULL)
+		return 0;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return 0;
+	}
+	uint64_t retval = buffer->tailSeq + emCircularPort_AtomicLoad(&buffer->NbElems);
+	emCircularPort_ExitCritical(buffer->sem);
+	return retval;
+}
+
+uint64_t emCircularGetTailSeq(const CBuffer_t *buffer)
+{
+	if (buffer == NULL)
+		return 0;
+	/* A single atomic load, no lock is needed */
+	return emCircularPort_AtomicLoad(&buffer->tailSeq);
+}
+
+CBStatus_t emCircularSetHistory(CBuffer_t *buffer, const size_t historyElems)
+{
+	if (buffer == NULL)
+		return CB_error;
+	if ((historyElems + 1) >= buffer->maxElems)
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	buffer->historyElems = historyElems;
+	if (buffer->NbHistory > historyElems)
+	{
+		buffer->NbHistory = historyElems;
+	}
+	emCircularPort_ExitCritical(buffer->sem);
+	return CB_true;
+}
+
+CBStatus_t emCircularRewind(CBuffer_t *buffer, const size_t nbElems)
+{
+	if (buffer == NULL)
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	CBStatus_t retval = CB_false;
+	if (nbElems <= buffer->NbHistory)
+	{
+		emCircularRewindUnlocked(buffer, nbElems);
+		retval = CB_true;
+	}
+	else
+	{
+		CB_DEBUG_Print("CB:\tNot enough elements in the history.\r\n");
+	}
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	if ((retval == CB_true) && (nbElems > 0))
+	{
+		emCircularNotify(buffer, CB_EventPush);
+	}
+	return retval;
+}
+
+CBStatus_t emCircularSeekTail(CBuffer_t *buffer, const uint64_t seq)
+{
+	if (buffer == NULL)
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	CBStatus_t retval = CB_false;
+	CBEvent_t notifyEvent = CB_EventNone;
+	if ((seq < buffer->tailSeq) && ((buffer->tailSeq - seq) <= buffer->NbHistory))
+	{
+		emCircularRewindUnlocked(buffer, (size_t)(buffer->tailSeq - seq));
+		notifyEvent = CB_EventPush;
+		retval = CB_true;
+	}
+	else if ((seq >= buffer->tailSeq) && ((seq - buffer->tailSeq) <= emCircularPort_AtomicLoad(&buffer->NbElems)))
+	{
+		if (seq > buffer->tailSeq)
+		{
+			notifyEvent = CB_EventPop;
+		}
+		emCircularConsumeUnlocked(buffer, (size_t)(seq - buffer->tailSeq));
+		retval = CB_true;
+	}
+	else
+	{
+		CB_DEBUG_Print("CB:\tSequence number is not in the buffer.\r\n");
+	}
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	if (notifyEvent != CB_EventNone)
+	{
+		emCircularNotify(buffer, notifyEvent);
+	}
+	return retval;
+}
+
+CBStatus_t emCircularSetWatermarks(CBuffer_t *buffer, const size_t lowWatermark, const size_t highWatermark,
+								   CBEventCallback_t callback, void *arg)
+{
+	if (buffer == NULL)
+		return CB_error;
+	if ((highWatermark != 0) && ((lowWatermark >= highWatermark) || (highWatermark >= buffer->maxElems)))
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	buffer->highWatermark = highWatermark;
+	buffer->lowWatermark = lowWatermark;
+	buffer->watermarkCb = callback;
+	buffer->watermarkArg = arg;
+	buffer->aboveWatermark = CB_false;
+	if ((highWatermark != 0) && (emCircularPort_AtomicLoad(&buffer->NbElems) >= highWatermark))
+	{
+		buffer->aboveWatermark = CB_true;
+	}
+	emCircularPort_ExitCritical(buffer->sem);
+	return CB_true;
+}
+
+CBStatus_t emCircularIsAboveWatermark(const CBuffer_t *buffer)
+{
+	if (buffer == NULL)
+		return CB_error;
+	return buffer->aboveWatermark;
+}
+
+#if CIRCULAR_USE_RATE_LIMIT
+CBStatus_t emCircularSetRateLimit(CBuffer_t *buffer, const uint32_t elemsPerSec, const uint32_t burstElems,
+								  const uint32_t bytesPerSec, const uint32_t burstBytes)
+{
+	if (buffer == NULL)
+		return CB_error;
+	if ((elemsPerSec != 0) && (burstElems < 1))
+		return CB_error;
+	if ((bytesPerSec != 0) && (burstBytes < buffer->elemSize))
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	uint64_t freq = emCircularPort_GetTickFreq();
+	buffer->rateElems = elemsPerSec;
+	buffer->rateBytes = bytesPerSec;
+	buffer->bucketElems = (uint64_t)burstElems * freq;
+	buffer->bucketBytes = (uint64_t)burstBytes * freq;
+	buffer->tokensElems = buffer->bucketElems;
+	buffer->tokensBytes = buffer->bucketBytes;
+	buffer->lastTick = emCircularPort_GetTick();
+	emCircularPort_ExitCritical(buffer->sem);
+	return CB_true;
+}
+#endif
+
+CBStatus_t emCircularPushSignalSafe(CBuffer_t *buffer, const void *elem)
+{
+	if ((buffer == NULL) || (elem == NULL))
+		return CB_error;
+	size_t index = emCircularReserveSlot(buffer);
+	if (index == buffer->maxElems)
+		return CB_false;
+	const unsigned char *src = (const unsigned char *)elem;
+	unsigned char *dst = buffer->startBuffer + (index * buffer->elemSize);
+	for (size_t i = 0; i < buffer->elemSize; i++)
+	{
+		dst[i] = src[i];
+	}
+	emCircularCommitSlots(buffer, index, 1);
+	emCircularNotify(buffer, CB_EventPush);
+	return CB_true;
+}
+
+CBStatus_t emCircularSetOverwrite(CBuffer_t *buffer, const CBStatus_t overwrite)
+{
+	if (buffer == NULL)
+		return CB_error;
+	if ((overwrite != CB_true) && (overwrite != CB_false))
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	buffer->overwrite = overwrite;
+	emCircularPort_ExitCritical(buffer->sem);
+	return CB_true;
+}
+
+CBStatus_t emCircularSetNotify(CBuffer_t *buffer, CBEventCallback_t callback, void *arg)
+{
+	if (buffer == NULL)
+		return CB_error;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return CB_error;
+	}
+	emCircularPort_AtomicStore(&buffer->notifyCb, NULL);
+	emCircularPort_AtomicStore(&buffer->notifyArg, arg);
+	emCircularPort_AtomicStore(&buffer->notifyCb, callback);
+	emCircularPort_ExitCritical(buffer->sem);
+	return CB_true;
+}
+
+size_t emCircularTransfer(CBuffer_t *dst, CBuffer_t *src, const size_t maxElems)
+{
+	if ((dst == NULL) || (src == NULL) || (dst == src))
+		return 0;
+	if (dst->elemSize != src->elemSize)
+		return 0;
+	/* The buffers are always locked in the same order, so opposite transfers cannot deadlock */
+	CBuffer_t *first = ((uintptr_t)dst < (uintptr_t)src) ? dst : src;
+	CBuffer_t *second = (first == dst) ? src : dst;
+	int sem_retval = emCircularPort_EnterCritical(first->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(first->sem);
+		return 0;
+	}
+	sem_retval = emCircularPort_EnterCritical(second->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(second->sem);
+		emCircularPort_ExitCritical(first->sem);
+		return 0;
+	}
+	size_t retval = emCircularPort_AtomicLoad(&src->NbElems);
+	if (retval > maxElems)
+	{
+		retval = maxElems;
+	}
+	size_t allowed = emCircularTakeTokensBatchUnlocked(dst, retval);
+	size_t dstInd = 0;
+	retval = 0;
+	if (allowed > 0)
+	{
+		retval = emCircularReserveSlots(dst, allowed, &dstInd);
+		emCircularRefundTokensUnlocked(dst, allowed - retval);
+	}
+	size_t firstInd = dstInd;
+	/* Both buffers can wrap, so the copy is split in at most three segments */
+	size_t srcInd = src->tailInd;
+	size_t left = retval;
+	while (left > 0)
+	{
+		size_t chunk = left;
+		if (chunk > (src->maxElems - srcInd))
+		{
+			chunk = src->maxElems - srcInd;
+		}
+		if (chunk > (dst->maxElems - dstInd))
+		{
+			chunk = dst->maxElems - dstInd;
+		}
+		memcpy(dst->startBuffer + (dstInd * dst->elemSize), src->startBuffer + (srcInd * src->elemSize),
+			   chunk * src->elemSize);
+		srcInd = (srcInd + chunk) % src->maxElems;
+		dstInd = (dstInd + chunk) % dst->maxElems;
+		left -= chunk;
+	}
+	CBEvent_t dstEvent = CB_EventNone;
+	CBEvent_t srcEvent = CB_EventNone;
+	if (retval > 0)
+	{
+		emCircularPort_AtomicStore(&dst->pendingSeq, UINT64_MAX);
+		emCircularCommitSlots(dst, firstInd, retval);
+		emCircularConsumeUnlocked(src, retval);
+		dstEvent = emCircularCheckWatermarkUnlocked(dst);
+		srcEvent = emCircularCheckWatermarkUnlocked(src);
+	}
+	emCircularPort_ExitCritical(second->sem);
+	emCircularPort_ExitCritical(first->sem);
+	if (retval > 0)
+	{
+		emCircularNotifyWatermark(dst, dstEvent);
+		emCircularNotifyWatermark(src, srcEvent);
+		emCircularNotify(dst, CB_EventPush);
+		emCircularNotify(src, CB_EventPop);
+	}
+	return retval;
+}
+
+void *emCircularGetHeadFront(CBuffer_t *buffer)
+{
+	if (buffer == NULL)
+		return NULL;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return NULL;
+	}
+#if CIRCULAR_USE_RATE_LIMIT
+	if (emCircularTakeTokensUnlocked(buffer) != CB_true)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tBuffer is rate limited.\r\n");
+		return NULL;
+	}
+#endif
+	/* The slot in front of the tail is the newest element of the history, or a free one */
+	size_t history = emCircularPort_AtomicLoad(&buffer->NbHistory);
+	size_t reserved = emCircularPort_AtomicLoad(&buffer->NbReserved);
+	do
+	{
+		if ((history == 0) && ((reserved + 1) >= buffer->maxElems))
+		{
+			emCircularRefundTokensUnlocked(buffer, 1);
+			emCircularPort_ExitCritical(buffer->sem);
+			CB_DEBUG_Print("CB:\tBuffer is full.\r\n");
+			return NULL;
+		}
+	} while (!emCircularPort_AtomicCAS(&buffer->NbReserved, &reserved, reserved + 1));
+	/* Only the newest element of the history is dropped, the older ones keep their slots */
+	if (history > 0)
+	{
+		emCircularPort_AtomicStore(&buffer->NbHistory, history - 1);
+	}
+	buffer->tailInd = (buffer->tailInd + buffer->maxElems - 1) % buffer->maxElems;
+	emCircularPort_AtomicStore(&buffer->tailSeq, buffer->tailSeq - 1);
+	emCircularPort_AtomicStore(&buffer->pendingSeq, buffer->tailSeq);
+	emCircularPort_AtomicFetchAdd(&buffer->rewinds, 1);
+	void *retval = (unsigned char *)buffer->startBuffer + (buffer->tailInd * buffer->elemSize);
+
+	CB_DEBUG_Print("CB:\tBuffer Tail pointer is %p.\r\n", retval);
+
+	emCircularPort_AtomicFetchAdd(&buffer->NbElems, 1);
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
+	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPush);
+	return retval;
+}
+
+void *emCircularUnpush(CBuffer_t *buffer)
+{
+	if (buffer == NULL)
+		return NULL;
+	int sem_retval = emCircularPort_EnterCritical(buffer->sem);
+	if (sem_retval != 0)
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		return NULL;
+	}
+	size_t nbElems = emCircularPort_AtomicLoad(&buffer->NbElems);
+	if ((nbElems == 0) || (emCircularPort_AtomicLoad(&buffer->NbReserved) != nbElems))
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tNo element to be removed from the head.\r\n");
+		return NULL;
+	}
+	size_t index = emCircularPort_AtomicLoad(&buffer->headInd);
+	size_t prev = (index + buffer->maxElems - 1) % buffer->maxElems;
+	if (!emCircularPort_AtomicCAS(&buffer->headInd, &index, prev))
+	{
+		emCircularPort_ExitCritical(buffer->sem);
+		CB_DEBUG_Print("CB:\tA push is in progress.\r\n");
+		return NULL;
+	}
+	emCircularPort_AtomicStore(&buffer->publishInd, prev);
+	emCircularPort_AtomicFetchAdd(&buffer->rewinds, 1);
+	void *retval = (unsigned char *)buffer->startBuffer + (prev * buffer->elemSize);
+
+	CB_DEBUG_Print("CB:\tBuffer Head pointer is %p.\r\n", retval);
+
+	emCircularPort_AtomicFetchSub(&buffer->NbElems, 1);
+	emCircularPort_AtomicFetchSub(&buffer->NbReserved, 1);
+	CBEvent_t event = emCircularCheckWatermarkUnlocked(buffer);
 	emCircularPort_ExitCritical(buffer->sem);
+	emCircularNotifyWatermark(buffer, event);
+	emCircularNotify(buffer, CB_EventPop);
 	return retval;
 }
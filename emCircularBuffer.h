@@ -32,6 +32,7 @@
 #define EMCIRCULARBUFFER_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 /*
  * Necessary to define the porting functions
@@ -53,6 +54,44 @@ typedef enum
 	CB_false
 } CBStatus_t;
 
+/*
+ * Definition of the events notified by the buffer
+ */
+typedef enum
+{
+	CB_EventNone = -1,
+	CB_EventHighWatermark,	// number of elements reached the high watermark
+	CB_EventLowWatermark,	// number of elements went back to the low watermark
+	CB_EventPush,			// elements were added, the buffer can be read
+	CB_EventPop				// elements were removed, the buffer can be written
+} CBEvent_t;
+
+struct CBuffer_t;
+
+/*
+ * Definition of the callback used to notify buffer events.
+ * It is called outside of the critical section of the buffer.
+ */
+typedef void (*CBEventCallback_t)(struct CBuffer_t *buffer, CBEvent_t event, void *arg);
+
+/*
+ * Definition of the function that reads the key of an element,
+ * e.g. a timestamp or the field used to partition the elements
+ */
+typedef uint64_t (*CBKeyExtractor_t)(const void *elem, void *arg);
+
+/*
+ * Definition of a range of elements of the buffer. The range can wrap at
+ * the end of the buffer memory, so it is made of two contiguous parts.
+ */
+typedef struct CBSpan_t
+{
+	void *first;			// pointer to the first element of the range
+	size_t firstNbElems;	// number of contiguous elements from first
+	void *second;			// pointer to the elements after the wrap, NULL if none
+	size_t secondNbElems;	// number of contiguous elements from second
+} CBSpan_t;
+
 /*
  * Definition of the circular buffer data type
  */
@@ -65,6 +104,34 @@ typedef struct CBuffer_t
 	size_t elemSize;			// dimension of the elements of the buffer
 	size_t maxElems;			// dimension of the buffer in terms of number of elements
 	size_t NbElems;				// actual number of elements in the buffer
+	size_t NbReserved;			// number of elements reserved by the producers, it includes
+								// the elements not yet published by emCircularPushSignalSafe()
+	unsigned char *committed;	// flag of every slot written by a producer and not yet published
+	size_t publishInd;			// index of the next slot to be published
+	size_t publishRequests;		// commits not yet seen by the producer that is publishing
+	uint64_t tailSeq;			// sequence number of the tail element, it never wraps
+	uint64_t pendingSeq;		// first element got with emCircularGetHead() that can be
+								// still unwritten, UINT64_MAX if none
+	uint64_t rewinds;			// number of times the head or the tail moved back
+	size_t historyElems;		// number of consumed elements to be retained
+	size_t NbHistory;			// actual number of consumed elements retained
+	size_t highWatermark;		// number of elements that raises CB_EventHighWatermark, 0 if disabled
+	size_t lowWatermark;		// number of elements that raises CB_EventLowWatermark
+	CBEventCallback_t watermarkCb; // callback for the watermark events, can be NULL
+	void *watermarkArg;			// user argument of the watermark callback
+	volatile CBStatus_t aboveWatermark; // CB_true from the high watermark until the low one
+	CBEventCallback_t notifyCb;	// callback for the push and pop events, can be NULL
+	void *notifyArg;			// user argument of the notify callback
+	CBStatus_t overwrite;		// CB_true if a push on a full buffer overwrites the tail element
+#if CIRCULAR_USE_RATE_LIMIT
+	uint32_t rateElems;			// elements per second allowed, 0 if not limited
+	uint32_t rateBytes;			// bytes per second allowed, 0 if not limited
+	uint64_t bucketElems;		// size of the element bucket, scaled by the tick frequency
+	uint64_t bucketBytes;		// size of the byte bucket, scaled by the tick frequency
+	uint64_t tokensElems;		// available element tokens, scaled by the tick frequency
+	uint64_t tokensBytes;		// available byte tokens, scaled by the tick frequency
+	uint32_t lastTick;			// tick of the last refill of the buckets
+#endif
 	CB_sem_t sem;				// semaphore to be used
 } CBuffer_t;
 
@@ -136,4 +203,307 @@ void *emCircularGetHead(CBuffer_t *buffer);
  */
 void *emCircularGetTail(CBuffer_t *buffer);
 
+/*
+ * @brief This function works like emCircularGetHead() and also returns the
+ * 		sequence number of the element reserved.
+ * 		Sequence numbers are free-running 64-bit counters: the first element
+ * 		pushed in the buffer has sequence 0 and they never wrap with the indexes.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param seq, pointer where the sequence number of the element is stored.
+ * 		Can be NULL. Not modified if the function returns NULL
+ * @return void*, pointer to the next free element of the buffer
+ */
+void *emCircularGetHeadWithSeq(CBuffer_t *buffer, uint64_t *seq);
+
+/*
+ * @brief This function works like emCircularGetTail() and also returns the
+ * 		sequence number of the element taken.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param seq, pointer where the sequence number of the element is stored.
+ * 		Can be NULL. Not modified if the function returns NULL
+ * @return void*, pointer to the next element of the buffer
+ * 		that has to be used/read
+ */
+void *emCircularGetTailWithSeq(CBuffer_t *buffer, uint64_t *seq);
+
+/*
+ * @brief This function works like emCircularGetHead() for up to nbElems
+ * 		elements at once, so the buffer is locked and the counters are updated
+ * 		once for the whole batch. The elements are published when the function
+ * 		returns, as for emCircularGetHead(). The overwrite mode is not applied.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param nbElems, number of elements requested
+ * @param span, filled with the elements reserved
+ * @return size_t, number of elements reserved, lower than nbElems
+ * 		if the buffer has not enough free space
+ */
+size_t emCircularGetHeadBatch(CBuffer_t *buffer, const size_t nbElems, CBSpan_t *span);
+
+/*
+ * @brief This function reserves up to nbElems elements at the head of the
+ * 		buffer, like emCircularGetHeadBatch(), without publishing them: the
+ * 		consumer sees them only after emCircularCommitHeadBatch(), so the caller
+ * 		can fill them first. In overwrite mode the tail elements are dropped to
+ * 		make room, as for emCircularGetHead().
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param nbElems, number of elements requested
+ * @param span, filled with the elements reserved
+ * @return size_t, number of elements reserved, lower than nbElems
+ * 		if the buffer has not enough free space
+ */
+size_t emCircularReserveHeadBatch(CBuffer_t *buffer, const size_t nbElems, CBSpan_t *span);
+
+/*
+ * @brief This function publishes the elements reserved with
+ * 		emCircularReserveHeadBatch(), once they are written. The elements are
+ * 		published in the order they were reserved.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param span, elements returned by emCircularReserveHeadBatch()
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularCommitHeadBatch(CBuffer_t *buffer, const CBSpan_t *span);
+
+/*
+ * @brief This function moves elements from the tail of src to the head of dst,
+ * 		as many as fit in dst, with a block copy of the contiguous parts of the
+ * 		two buffers. Both buffers are locked once for the whole transfer.
+ * 		The elements are visible in dst only after they are copied. The caller
+ * 		must be the only consumer of src and the overwrite mode of dst is not applied.
+ *
+ * @param dst, pointer to the circular buffer where the elements are pushed
+ * @param src, pointer to the circular buffer where the elements are taken.
+ * 		Its elements must have the same size of the ones of dst
+ * @param maxElems, maximum number of elements to be moved
+ * @return size_t, number of elements moved
+ */
+size_t emCircularTransfer(CBuffer_t *dst, CBuffer_t *src, const size_t maxElems);
+
+/*
+ * @brief This function is used to get the pointer to a free element in
+ * 		front of the tail, i.e. the element becomes the next one to be
+ * 		taken (push-front). Its sequence number is the one of the old tail
+ * 		minus one, i.e. the one of an element already consumed: the sequence
+ * 		numbers do not identify the elements uniquely when this function is used.
+ * 		The slot is the one of the newest element of the history, that is dropped.
+ * 		It moves the tail, so when no locking mechanism is defined it must
+ * 		be called by the consumer thread. The overwrite mode is not applied.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @return void*, pointer to the new tail element. Returns NULL
+ * 		if the buffer is full
+ */
+void *emCircularGetHeadFront(CBuffer_t *buffer);
+
+/*
+ * @brief This function removes the last element pushed at the head of the
+ * 		buffer (pop-back), e.g. to undo a speculative push. It fails while a
+ * 		push of emCircularPushSignalSafe() is in progress.
+ * 		When no locking mechanism is defined it must not be called while the
+ * 		consumer can take the same element.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @return void*, pointer to the element removed, valid until the next push.
+ * 		Returns NULL if the buffer is empty
+ */
+void *emCircularUnpush(CBuffer_t *buffer);
+
+/*
+ * @brief This function is used to get the pointer to the next
+ * 		block of memory to be read without taking it from the buffer.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param seq, pointer where the sequence number of the element is stored.
+ * 		Can be NULL. Not modified if the function returns NULL
+ * @return void*, pointer to the tail element. Returns NULL if the
+ * 		buffer is empty
+ */
+void *emCircularPeekTail(const CBuffer_t *buffer, uint64_t *seq);
+
+/*
+ * @brief This function is used to get the pointer to the element with
+ * 		the given sequence number, without taking it from the buffer.
+ * 		Consumed elements still retained in the history window
+ * 		(see emCircularSetHistory()) can be accessed too.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param seq, sequence number of the element
+ * @return void*, pointer to the element. Returns NULL if the element
+ * 		is no longer (or not yet) in the buffer
+ */
+void *emCircularPeekSeq(const CBuffer_t *buffer, uint64_t seq);
+
+/*
+ * @brief This function is used to get the sequence number that will be
+ * 		assigned to the next element pushed in the buffer.
+ *
+ * @param buffer, pointer to the circular buffer to be checked
+ * @return uint64_t, sequence number of the head
+ */
+uint64_t emCircularGetHeadSeq(const CBuffer_t *buffer);
+
+/*
+ * @brief This function is used to get the sequence number of the next
+ * 		element to be taken from the buffer. The difference between
+ * 		head and tail sequence numbers is the number of elements in the buffer.
+ * 		It does not take the lock, so it can be called from a signal handler.
+ *
+ * @param buffer, pointer to the circular buffer to be checked
+ * @return uint64_t, sequence number of the tail
+ */
+uint64_t emCircularGetTailSeq(const CBuffer_t *buffer);
+
+/*
+ * @brief This function configures the history retention of the buffer.
+ * 		The last historyElems elements taken with emCircularGetTail() are
+ * 		retained: their slots cannot be reused by emCircularGetHead() until
+ * 		they fall out of the history window, so the consumer can take them
+ * 		again with emCircularRewind() or emCircularSeekTail().
+ * 		The retained elements reduce the free space of the buffer.
+ *
+ * @param buffer, pointer to the circular buffer to be configured
+ * @param historyElems, number of elements of the history window. Must be
+ * 		lower than maxElems - 1. Set to 0 to disable the retention
+ * @return CBStatus_t, return value. Returns CB_true if the history window
+ * 		was configured, CB_error otherwise
+ */
+CBStatus_t emCircularSetHistory(CBuffer_t *buffer, const size_t historyElems);
+
+/*
+ * @brief This function moves the tail of the buffer back by nbElems elements,
+ * 		so the last nbElems elements consumed are taken again by the next
+ * 		emCircularGetTail() calls.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param nbElems, number of elements to rewind
+ * @return CBStatus_t, return value. Returns CB_true if the tail was moved,
+ * 		CB_false if less than nbElems elements are retained in the history
+ */
+CBStatus_t emCircularRewind(CBuffer_t *buffer, const size_t nbElems);
+
+/*
+ * @brief This function moves the tail of the buffer to the element with the
+ * 		given sequence number. Moving the tail backwards takes elements from
+ * 		the history, moving it forwards consumes the elements skipped.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param seq, sequence number of the next element to be taken
+ * @return CBStatus_t, return value. Returns CB_true if the tail was moved,
+ * 		CB_false if seq is out of the history and of the buffer elements
+ */
+CBStatus_t emCircularSeekTail(CBuffer_t *buffer, const uint64_t seq);
+
+/*
+ * @brief This function configures the watermarks of the buffer for the
+ * 		flow control. When the number of elements reaches highWatermark the
+ * 		CB_EventHighWatermark event is notified once, then nothing else is
+ * 		notified until the number of elements goes down to lowWatermark,
+ * 		that notifies CB_EventLowWatermark once.
+ *
+ * @param buffer, pointer to the circular buffer to be configured
+ * @param lowWatermark, number of elements for the low watermark
+ * @param highWatermark, number of elements for the high watermark. Must be
+ * 		greater than lowWatermark. Set to 0 to disable the watermarks
+ * @param callback, function called on every watermark event. Can be NULL
+ * 		if the state is only polled with emCircularIsAboveWatermark()
+ * @param arg, user argument passed to the callback
+ * @return CBStatus_t, return value. Returns CB_true if the watermarks
+ * 		were configured, CB_error otherwise
+ */
+CBStatus_t emCircularSetWatermarks(CBuffer_t *buffer, const size_t lowWatermark, const size_t highWatermark,
+								   CBEventCallback_t callback, void *arg);
+
+/*
+ * @brief This function is used to know if the buffer is above the watermark,
+ * 		i.e. the high watermark was reached and the low one was not reached yet.
+ * 		It does not lock the buffer, so it can be polled cheaply.
+ *
+ * @param buffer, pointer to the circular buffer to be checked
+ * @return CBStatus_t, return value. Returns CB_true if the buffer
+ * 		is above the watermark, CB_false otherwise
+ */
+CBStatus_t emCircularIsAboveWatermark(const CBuffer_t *buffer);
+
+/*
+ * @brief This function copies an element at the head of the buffer and it is
+ * 		async-signal-safe: it can be called from a signal or interrupt handler.
+ * 		It does not lock the buffer, does not allocate memory and does not
+ * 		print debug messages: the slot is reserved with lock-free atomic
+ * 		operations (see emCircularPort.h) and the element is visible to the
+ * 		consumer only after it is completely copied. The elements are published
+ * 		in the order of their slots, so an element reserved after one still being
+ * 		copied (also by emCircularGetHead()) becomes visible after it.
+ * 		It can interrupt, and be interrupted by, emCircularGetHead() or another
+ * 		emCircularPushSignalSafe() on the same buffer, also on the same thread.
+ * 		The rate limiter and the watermark events are not applied to the
+ * 		elements pushed with this function.
+ *
+ * @param buffer, pointer to the circular buffer to be used
+ * @param elem, pointer to the element to be copied
+ * @return CBStatus_t, return value. Returns CB_true if the element was
+ * 		pushed, CB_false if the buffer is full
+ */
+CBStatus_t emCircularPushSignalSafe(CBuffer_t *buffer, const void *elem);
+
+/*
+ * @brief This function enables or disables the overwrite mode of the buffer.
+ * 		In overwrite mode emCircularGetHead() on a full buffer drops the tail
+ * 		element (moving it in the history, if enabled) instead of returning NULL.
+ * 		The tail is moved by the producer, so when no locking mechanism is defined
+ * 		the buffer must not be consumed at the same time by another thread.
+ * 		emCircularPushSignalSafe() never overwrites elements.
+ *
+ * @param buffer, pointer to the circular buffer to be configured
+ * @param overwrite, CB_true to enable the overwrite mode, CB_false to disable it
+ * @return CBStatus_t, return value. Returns CB_true if the mode was
+ * 		configured, CB_error otherwise
+ */
+CBStatus_t emCircularSetOverwrite(CBuffer_t *buffer, const CBStatus_t overwrite);
+
+/*
+ * @brief This function configures the callback notified after every change
+ * 		of the elements of the buffer: CB_EventPush when elements are added
+ * 		(emCircularGetHead(), emCircularPushSignalSafe(), emCircularRewind(),
+ * 		emCircularSeekTail() backwards) and CB_EventPop when they are removed
+ * 		(emCircularGetTail(), emCircularSeekTail() forwards).
+ * 		It is meant to wake the threads waiting on the buffer, see emCircularWaiter.h.
+ * 		The callback is called by emCircularPushSignalSafe() too, so it must be
+ * 		async-signal-safe if that function is used.
+ *
+ * @param buffer, pointer to the circular buffer to be configured
+ * @param callback, function called on every push and pop event. Can be NULL
+ * 		to disable the notifications
+ * @param arg, user argument passed to the callback
+ * @return CBStatus_t, return value. Returns CB_true if the callback
+ * 		was configured, CB_error otherwise
+ */
+CBStatus_t emCircularSetNotify(CBuffer_t *buffer, CBEventCallback_t callback, void *arg);
+
+#if CIRCULAR_USE_RATE_LIMIT
+/*
+ * @brief This function configures the token bucket rate limiter of the
+ * 		buffer producer. When there are no tokens left emCircularGetHead()
+ * 		returns NULL as if the buffer was full.
+ * 		The buckets are refilled when a push is done, reading the tick
+ * 		counter defined in emCircularPort.h, so no timer is needed.
+ *
+ * @param buffer, pointer to the circular buffer to be configured
+ * @param elemsPerSec, number of elements per second allowed. Set to 0
+ * 		to disable the limit on the elements
+ * @param burstElems, maximum number of elements that can be pushed in a burst
+ * @param bytesPerSec, number of bytes per second allowed. Set to 0
+ * 		to disable the limit on the bytes
+ * @param burstBytes, maximum number of bytes that can be pushed in a burst.
+ * 		Must not be lower than the element size
+ * @return CBStatus_t, return value. Returns CB_true if the rate limiter
+ * 		was configured, CB_error otherwise
+ */
+CBStatus_t emCircularSetRateLimit(CBuffer_t *buffer, const uint32_t elemsPerSec, const uint32_t burstElems,
+								  const uint32_t bytesPerSec, const uint32_t burstBytes);
+#endif
+
 #endif /* EMCIRCULARBUFFER_H_ */
@@ -0,0 +1,239 @@
+/*
+ * @file emCircularCache.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularCache.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the home position of a key in the index, the key is mixed with
+ * the 64-bit finalizer of MurmurHash3
+ */
+static size_t emCircularCacheHome(const CBCache_t *cache, uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return (size_t)key & cache->indexMask;
+}
+
+/*
+ * Returns the position of a key in the index, or the empty position
+ * where it would be inserted
+ */
+static size_t emCircularCacheFind(const CBCache_t *cache, const uint64_t key)
+{
+	size_t pos = emCircularCacheHome(cache, key);
+	while ((cache->index[pos] != 0) && (cache->keys[cache->index[pos] - 1] != key))
+	{
+		pos = (pos + 1) & cache->indexMask;
+	}
+	return pos;
+}
+
+/*
+ * Empties a position of the index, moving back the following entries of
+ * the probe sequence so that no tombstone is needed
+ */
+static void emCircularCacheUnlink(CBCache_t *cache, size_t pos)
+{
+	size_t next = pos;
+	cache->index[pos] = 0;
+	for (;;)
+	{
+		next = (next + 1) & cache->indexMask;
+		if (cache->index[next] == 0)
+			break;
+		size_t home = emCircularCacheHome(cache, cache->keys[cache->index[next] - 1]);
+		/* The entry stays if its home is cyclically in (pos, next] */
+		int stays = (pos <= next) ? ((pos < home) && (home <= next)) : ((pos < home) || (home <= next));
+		if (stays)
+			continue;
+		cache->index[pos] = cache->index[next];
+		cache->index[next] = 0;
+		pos = next;
+	}
+}
+
+/*
+ * Takes a slot with the CLOCK policy: the hand clears the reference bits
+ * until it finds a slot not referenced, that is evicted
+ */
+static size_t emCircularCacheEvict(CBCache_t *cache, CBStatus_t *evicted, uint64_t *evictedKey)
+{
+	while (cache->refBits[cache->hand] != 0)
+	{
+		cache->refBits[cache->hand] = 0;
+		cache->hand = (cache->hand + 1) % cache->capacity;
+	}
+	size_t slot = cache->hand;
+	cache->hand = (cache->hand + 1) % cache->capacity;
+	emCircularCacheUnlink(cache, emCircularCacheFind(cache, cache->keys[slot]));
+	if (evicted != NULL)
+	{
+		*evicted = CB_true;
+	}
+	if (evictedKey != NULL)
+	{
+		*evictedKey = cache->keys[slot];
+	}
+	return slot;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBCache_t *emCircularCacheInit(const size_t capacity, const size_t valueSize)
+{
+	if ((capacity < 1) || (valueSize < 1))
+		return NULL;
+	/* The index is kept at most half full, so the probe sequences stay short */
+	size_t indexSize = 2;
+	while (indexSize < (2 * capacity))
+	{
+		indexSize *= 2;
+	}
+	CBCache_t *retval = (CBCache_t *)emCircularPortMalloc(sizeof(CBCache_t));
+	if (retval == NULL)
+		return NULL;
+	retval->startBuffer = (unsigned char *)emCircularPortMalloc(capacity * valueSize);
+	retval->keys = (uint64_t *)emCircularPortMalloc(capacity * sizeof(uint64_t));
+	retval->refBits = (unsigned char *)emCircularPortMalloc(capacity);
+	retval->freeSlots = (size_t *)emCircularPortMalloc(capacity * sizeof(size_t));
+	retval->index = (size_t *)emCircularPortMalloc(indexSize * sizeof(size_t));
+	if ((retval->startBuffer == NULL) || (retval->keys == NULL) || (retval->refBits == NULL) ||
+		(retval->freeSlots == NULL) || (retval->index == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the cache!\r\n");
+		emCircularCacheDelete(retval);
+		return NULL;
+	}
+	memset(retval->refBits, 0, capacity);
+	memset(retval->index, 0, indexSize * sizeof(size_t));
+	for (size_t i = 0; i < capacity; i++)
+	{
+		retval->freeSlots[i] = capacity - 1 - i;
+	}
+	retval->valueSize = valueSize;
+	retval->capacity = capacity;
+	retval->hand = 0;
+	retval->nbFree = capacity;
+	retval->indexMask = indexSize - 1;
+	CB_DEBUG_Print("CB:\tCache initialised. Cache pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularCacheDelete(CBCache_t *cache)
+{
+	if (cache == NULL)
+		return CB_error;
+	if (cache->startBuffer != NULL)
+		emCircularPortFree(cache->startBuffer);
+	if (cache->keys != NULL)
+		emCircularPortFree(cache->keys);
+	if (cache->refBits != NULL)
+		emCircularPortFree(cache->refBits);
+	if (cache->freeSlots != NULL)
+		emCircularPortFree(cache->freeSlots);
+	if (cache->index != NULL)
+		emCircularPortFree(cache->index);
+	emCircularPortFree(cache);
+	return CB_true;
+}
+
+void *emCircularCacheGet(CBCache_t *cache, const uint64_t key)
+{
+	if (cache == NULL)
+		return NULL;
+	size_t pos = emCircularCacheFind(cache, key);
+	if (cache->index[pos] == 0)
+		return NULL;
+	size_t slot = cache->index[pos] - 1;
+	cache->refBits[slot] = 1;
+	return cache->startBuffer + (slot * cache->valueSize);
+}
+
+void *emCircularCachePut(CBCache_t *cache, const uint64_t key, CBStatus_t *evicted, uint64_t *evictedKey)
+{
+	if (cache == NULL)
+		return NULL;
+	if (evicted != NULL)
+	{
+		*evicted = CB_false;
+	}
+	size_t pos = emCircularCacheFind(cache, key);
+	size_t slot;
+	if (cache->index[pos] != 0)
+	{
+		slot = cache->index[pos] - 1;
+	}
+	else
+	{
+		if (cache->nbFree > 0)
+		{
+			slot = cache->freeSlots[--cache->nbFree];
+		}
+		else
+		{
+			slot = emCircularCacheEvict(cache, evicted, evictedKey);
+			/* The eviction can move the entries of the index */
+			pos = emCircularCacheFind(cache, key);
+		}
+		cache->keys[slot] = key;
+		cache->index[pos] = slot + 1;
+	}
+	cache->refBits[slot] = 1;
+	return cache->startBuffer + (slot * cache->valueSize);
+}
+
+CBStatus_t emCircularCacheRemove(CBCache_t *cache, const uint64_t key)
+{
+	if (cache == NULL)
+		return CB_error;
+	size_t pos = emCircularCacheFind(cache, key);
+	if (cache->index[pos] == 0)
+		return CB_false;
+	size_t slot = cache->index[pos] - 1;
+	emCircularCacheUnlink(cache, pos);
+	cache->refBits[slot] = 0;
+	cache->freeSlots[cache->nbFree++] = slot;
+	return CB_true;
+}
+
+size_t emCircularCacheGetNbEntries(const CBCache_t *cache)
+{
+	if (cache == NULL)
+		return 0;
+	return cache->capacity - cache->nbFree;
+}
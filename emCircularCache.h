@@ -0,0 +1,114 @@
+/*
+ * @file emCircularCache.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a fixed-capacity cache with CLOCK eviction.
+ *
+ * The values live in contiguous slots of fixed size, as the elements of
+ * emCircularBuffer, with a reference bit for every slot. When the cache is full
+ * a clock hand sweeps the slots like the tail of a circular buffer, clearing the
+ * reference bits, and evicts the first slot not referenced since the last sweep.
+ * The keys are found with an open addressing index (linear probing, deletion by
+ * backward shift), so get and put are O(1) with fixed memory and no allocation
+ * after the init. The cache is not thread safe.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARCACHE_H_
+#define EMCIRCULARCACHE_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the cache data type
+ */
+typedef struct CBCache_t
+{
+	unsigned char *startBuffer; // memory of the values
+	size_t valueSize;			// size in bytes of a value
+	size_t capacity;			// number of slots
+	uint64_t *keys;				// key of every slot
+	unsigned char *refBits;		// reference bit of every slot
+	size_t hand;				// slot checked next by the clock hand
+	size_t *freeSlots;			// stack of the slots not used
+	size_t nbFree;				// number of slots not used
+	size_t *index;				// open addressing index, slot + 1 or 0 if empty
+	size_t indexMask;			// size of the index minus one, the size is a power of two
+} CBCache_t;
+
+/*
+ * @brief This function initializes the cache allocating all its memory.
+ *
+ * @param capacity, maximum number of entries
+ * @param valueSize, size of every value in terms of bytes
+ * @return CBCache_t*, pointer to the cache created. Returns
+ * 		NULL if it was not possible to create the cache
+ */
+CBCache_t *emCircularCacheInit(const size_t capacity, const size_t valueSize);
+
+/*
+ * @brief This function deletes the cache and frees its memory.
+ *
+ * @param cache, pointer to the cache to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularCacheDelete(CBCache_t *cache);
+
+/*
+ * @brief This function looks up a key and marks its slot as referenced.
+ *
+ * @param cache, pointer to the cache to be used
+ * @param key, key to be found
+ * @return void*, pointer to the value of the key. Returns NULL if
+ * 		the key is not in the cache
+ */
+void *emCircularCacheGet(CBCache_t *cache, const uint64_t key);
+
+/*
+ * @brief This function is used to get the slot of the value of a key, to
+ * 		be written by the caller. If the key is not in the cache a slot is
+ * 		taken, evicting an entry with the CLOCK policy if the cache is full.
+ *
+ * @param cache, pointer to the cache to be used
+ * @param key, key of the value
+ * @param evicted, filled with CB_true if an entry was evicted, CB_false otherwise. Can be NULL
+ * @param evictedKey, filled with the key of the entry evicted. Can be NULL
+ * @return void*, pointer to the value of the key
+ */
+void *emCircularCachePut(CBCache_t *cache, const uint64_t key, CBStatus_t *evicted, uint64_t *evictedKey);
+
+/*
+ * @brief This function removes a key from the cache.
+ *
+ * @param cache, pointer to the cache to be used
+ * @param key, key to be removed
+ * @return CBStatus_t, return value. Returns CB_true if the key was
+ * 		removed, CB_false if it was not in the cache
+ */
+CBStatus_t emCircularCacheRemove(CBCache_t *cache, const uint64_t key);
+
+/*
+ * @brief This function returns the number of entries in the cache.
+ *
+ * @param cache, pointer to the cache to be checked
+ * @return size_t, number of entries
+ */
+size_t emCircularCacheGetNbEntries(const CBCache_t *cache);
+
+#endif /* EMCIRCULARCACHE_H_ */
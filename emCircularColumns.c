@@ -0,0 +1,193 @@
+/*
+ * @file emCircularColumns.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularColumns.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the size of the memory of a column, rounded up to keep the next one aligned
+ */
+static size_t emCircularColumnSize(const CBColumns_t *columns, const size_t field)
+{
+	size_t size = columns->maxElems * columns->fields[field].size;
+	return (size + CB_COLUMNS_ALIGN - 1) & ~((size_t)CB_COLUMNS_ALIGN - 1);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBColumns_t *emCircularColumnsInit(const size_t maxElems, const CBColumnField_t *fields, const size_t nbFields)
+{
+	if ((maxElems < 1) || (fields == NULL) || (nbFields < 1))
+		return NULL;
+	for (size_t i = 0; i < nbFields; i++)
+	{
+		if (fields[i].size < 1)
+			return NULL;
+	}
+	CBColumns_t *retval = (CBColumns_t *)emCircularPortMalloc(sizeof(CBColumns_t));
+	if (retval == NULL)
+		return NULL;
+	retval->memory = NULL;
+	retval->maxElems = maxElems;
+	retval->nbFields = nbFields;
+	retval->headCount = 0;
+	retval->tailCount = 0;
+	retval->columns = (unsigned char **)emCircularPortMalloc(nbFields * sizeof(unsigned char *));
+	retval->fields = (CBColumnField_t *)emCircularPortMalloc(nbFields * sizeof(CBColumnField_t));
+	if ((retval->columns == NULL) || (retval->fields == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the columns!\r\n");
+		emCircularColumnsDelete(retval);
+		return NULL;
+	}
+	memcpy(retval->fields, fields, nbFields * sizeof(CBColumnField_t));
+	/* All the columns are in a single allocation, every one aligned */
+	size_t totalSize = CB_COLUMNS_ALIGN - 1;
+	for (size_t i = 0; i < nbFields; i++)
+	{
+		totalSize += emCircularColumnSize(retval, i);
+	}
+	retval->memory = (unsigned char *)emCircularPortMalloc(totalSize);
+	if (retval->memory == NULL)
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the columns!\r\n");
+		emCircularColumnsDelete(retval);
+		return NULL;
+	}
+	unsigned char *column = (unsigned char *)(((uintptr_t)retval->memory + CB_COLUMNS_ALIGN - 1) & ~((uintptr_t)CB_COLUMNS_ALIGN - 1));
+	for (size_t i = 0; i < nbFields; i++)
+	{
+		retval->columns[i] = column;
+		column += emCircularColumnSize(retval, i);
+	}
+	CB_DEBUG_Print("CB:\tColumnar buffer initialised. Buffer pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularColumnsDelete(CBColumns_t *columns)
+{
+	if (columns == NULL)
+		return CB_error;
+	if (columns->memory != NULL)
+		emCircularPortFree(columns->memory);
+	if (columns->columns != NULL)
+		emCircularPortFree(columns->columns);
+	if (columns->fields != NULL)
+		emCircularPortFree(columns->fields);
+	emCircularPortFree(columns);
+	return CB_true;
+}
+
+CBStatus_t emCircularColumnsPush(CBColumns_t *columns, const void *record)
+{
+	if ((columns == NULL) || (record == NULL))
+		return CB_error;
+	uint64_t head = columns->headCount;
+	if ((head - emCircularPort_AtomicLoad(&columns->tailCount)) >= columns->maxElems)
+	{
+		CB_DEBUG_Print("CB:\tThe columnar buffer is full.\r\n");
+		return CB_false;
+	}
+	size_t index = (size_t)(head % columns->maxElems);
+	for (size_t i = 0; i < columns->nbFields; i++)
+	{
+		const CBColumnField_t *field = &columns->fields[i];
+		memcpy(columns->columns[i] + (index * field->size), (const unsigned char *)record + field->offset, field->size);
+	}
+	emCircularPort_AtomicStore(&columns->headCount, head + 1);
+	return CB_true;
+}
+
+CBStatus_t emCircularColumnsPop(CBColumns_t *columns, void *record)
+{
+	if ((columns == NULL) || (record == NULL))
+		return CB_error;
+	uint64_t tail = columns->tailCount;
+	if (emCircularPort_AtomicLoad(&columns->headCount) == tail)
+		return CB_false;
+	size_t index = (size_t)(tail % columns->maxElems);
+	for (size_t i = 0; i < columns->nbFields; i++)
+	{
+		const CBColumnField_t *field = &columns->fields[i];
+		memcpy((unsigned char *)record + field->offset, columns->columns[i] + (index * field->size), field->size);
+	}
+	emCircularPort_AtomicStore(&columns->tailCount, tail + 1);
+	return CB_true;
+}
+
+size_t emCircularColumnsGetWindow(const CBColumns_t *columns, const size_t field, size_t nbElems, CBSpan_t *window)
+{
+	if ((columns == NULL) || (field >= columns->nbFields) || (window == NULL))
+		return 0;
+	uint64_t tail = columns->tailCount;
+	size_t available = (size_t)(emCircularPort_AtomicLoad(&columns->headCount) - tail);
+	if (nbElems > available)
+	{
+		nbElems = available;
+	}
+	size_t index = (size_t)(tail % columns->maxElems);
+	size_t firstNbElems = columns->maxElems - index;
+	if (firstNbElems > nbElems)
+	{
+		firstNbElems = nbElems;
+	}
+	size_t size = columns->fields[field].size;
+	window->first = (nbElems > 0) ? (columns->columns[field] + (index * size)) : NULL;
+	window->firstNbElems = firstNbElems;
+	window->second = (firstNbElems < nbElems) ? columns->columns[field] : NULL;
+	window->secondNbElems = nbElems - firstNbElems;
+	return nbElems;
+}
+
+size_t emCircularColumnsRelease(CBColumns_t *columns, size_t nbElems)
+{
+	if (columns == NULL)
+		return 0;
+	uint64_t tail = columns->tailCount;
+	size_t available = (size_t)(emCircularPort_AtomicLoad(&columns->headCount) - tail);
+	if (nbElems > available)
+	{
+		nbElems = available;
+	}
+	emCircularPort_AtomicStore(&columns->tailCount, tail + nbElems);
+	return nbElems;
+}
+
+size_t emCircularColumnsGetNbElems(const CBColumns_t *columns)
+{
+	if (columns == NULL)
+		return 0;
+	uint64_t tail = emCircularPort_AtomicLoad(&columns->tailCount);
+	return (size_t)(emCircularPort_AtomicLoad(&columns->headCount) - tail);
+}
@@ -0,0 +1,138 @@
+/*
+ * @file emCircularColumns.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a columnar circular buffer of records.
+ *
+ * The records are described by a schema of fields, and every field is stored in
+ * its own column: a circular buffer of elements of the size of the field, all
+ * sharing the same head and tail. A push scatters the fields of a record in the
+ * columns and a pop gathers them back, while the readable elements of a single
+ * column are returned as a contiguous window (two parts if it wraps), so the
+ * analytics on one field run on packed data instead of a strided gather.
+ * Every column is aligned to CB_COLUMNS_ALIGN bytes for SIMD kernels.
+ * The buffer is lock-free for one producer and one consumer.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARCOLUMNS_H_
+#define EMCIRCULARCOLUMNS_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_COLUMNS_ALIGN 64 // alignment in bytes of every column, must be a power of two
+
+/*
+ * Definition of a field of the schema
+ */
+typedef struct CBColumnField_t
+{
+	size_t offset;	// offset in bytes of the field in the record (e.g. offsetof())
+	size_t size;	// size in bytes of the field
+} CBColumnField_t;
+
+/*
+ * Definition of the columnar buffer data type
+ */
+typedef struct CBColumns_t
+{
+	unsigned char *memory;		// memory allocated for all the columns
+	unsigned char **columns;	// first element of every column
+	CBColumnField_t *fields;	// schema of the records
+	size_t nbFields;			// number of fields and columns
+	size_t maxElems;			// number of records of the buffer
+	uint64_t headCount;			// number of records pushed
+	uint64_t tailCount;			// number of records released
+} CBColumns_t;
+
+/*
+ * @brief This function initializes the columnar buffer allocating all the columns.
+ *
+ * @param maxElems, number of records of the buffer
+ * @param fields, schema of the records. It is copied
+ * @param nbFields, number of fields of the schema
+ * @return CBColumns_t*, pointer to the columnar buffer created. Returns
+ * 		NULL if it was not possible to create the columnar buffer
+ */
+CBColumns_t *emCircularColumnsInit(const size_t maxElems, const CBColumnField_t *fields, const size_t nbFields);
+
+/*
+ * @brief This function deletes the columnar buffer and frees its memory.
+ *
+ * @param columns, pointer to the columnar buffer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularColumnsDelete(CBColumns_t *columns);
+
+/*
+ * @brief This function pushes a record, copying every field in its column.
+ *
+ * @param columns, pointer to the columnar buffer to be used
+ * @param record, pointer to the record, with the fields at the offsets of the schema
+ * @return CBStatus_t, return value. Returns CB_true if the record was pushed,
+ * 		CB_false if the buffer is full
+ */
+CBStatus_t emCircularColumnsPush(CBColumns_t *columns, const void *record);
+
+/*
+ * @brief This function pops the oldest record, copying every field from its column.
+ *
+ * @param columns, pointer to the columnar buffer to be used
+ * @param record, pointer where the fields are copied, at the offsets of the schema
+ * @return CBStatus_t, return value. Returns CB_true if a record was popped,
+ * 		CB_false if the buffer is empty
+ */
+CBStatus_t emCircularColumnsPop(CBColumns_t *columns, void *record);
+
+/*
+ * @brief This function returns the window of the readable elements of a column,
+ * 		from the oldest one. The elements stay in the buffer until they are
+ * 		released with emCircularColumnsRelease(). Called with the same nbElems,
+ * 		every column returns the same records.
+ *
+ * @param columns, pointer to the columnar buffer to be used
+ * @param field, index of the field in the schema
+ * @param nbElems, maximum number of elements of the window
+ * @param window, filled with the parts of the window
+ * @return size_t, number of elements of the window
+ */
+size_t emCircularColumnsGetWindow(const CBColumns_t *columns, const size_t field, size_t nbElems, CBSpan_t *window);
+
+/*
+ * @brief This function releases the oldest records, read through the windows.
+ *
+ * @param columns, pointer to the columnar buffer to be used
+ * @param nbElems, number of records to be released
+ * @return size_t, number of records released, lower than nbElems if the
+ * 		buffer has less records
+ */
+size_t emCircularColumnsRelease(CBColumns_t *columns, size_t nbElems);
+
+/*
+ * @brief This function returns the number of records in the buffer.
+ *
+ * @param columns, pointer to the columnar buffer to be checked
+ * @return size_t, number of records
+ */
+size_t emCircularColumnsGetNbElems(const CBColumns_t *columns);
+
+#endif /* EMCIRCULARCOLUMNS_H_ */
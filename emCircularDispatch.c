@@ -0,0 +1,230 @@
+/*
+ * @file emCircularDispatch.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularDispatch.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * 64-bit finalizer of MurmurHash3
+ */
+static uint64_t emCircularDispatchMix(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+/*
+ * Copies the elements of one output, listed in order, in the reserved span
+ */
+static void emCircularDispatchCopy(const CBDispatcher_t *dispatcher, const unsigned char *elems, const size_t *order,
+								   const CBSpan_t *span)
+{
+	unsigned char *dst = (unsigned char *)span->first;
+	for (size_t i = 0; i < (span->firstNbElems + span->secondNbElems); i++)
+	{
+		if (i == span->firstNbElems)
+		{
+			dst = (unsigned char *)span->second;
+		}
+		memcpy(dst, elems + (order[i] * dispatcher->elemSize), dispatcher->elemSize);
+		dst += dispatcher->elemSize;
+	}
+}
+
+/*
+ * Dispatches a chunk of up to maxBatch elements
+ */
+static size_t emCircularDispatchChunk(CBDispatcher_t *dispatcher, const unsigned char *elems, const size_t nbElems,
+									  CBStatus_t *status)
+{
+	size_t retval = 0;
+	memset(dispatcher->counts, 0, dispatcher->nbOutputs * sizeof(size_t));
+	for (size_t i = 0; i < nbElems; i++)
+	{
+		size_t partition = emCircularDispatchPartition(dispatcher, elems + (i * dispatcher->elemSize));
+		dispatcher->partitions[i] = partition;
+		dispatcher->counts[partition]++;
+	}
+	/* counts becomes the start of every output in order, then its end after the placement */
+	size_t start = 0;
+	for (size_t p = 0; p < dispatcher->nbOutputs; p++)
+	{
+		size_t count = dispatcher->counts[p];
+		dispatcher->counts[p] = start;
+		start += count;
+	}
+	for (size_t i = 0; i < nbElems; i++)
+	{
+		dispatcher->order[dispatcher->counts[dispatcher->partitions[i]]++] = i;
+	}
+	start = 0;
+	for (size_t p = 0; p < dispatcher->nbOutputs; p++)
+	{
+		size_t end = dispatcher->counts[p];
+		if (end == start)
+			continue;
+		CBSpan_t span;
+		/* The elements are published only once copied, the consumer of the output can run concurrently */
+		size_t reserved = emCircularReserveHeadBatch(dispatcher->outputs[p], end - start, &span);
+		if (reserved > 0)
+		{
+			emCircularDispatchCopy(dispatcher, elems, &dispatcher->order[start], &span);
+			emCircularCommitHeadBatch(dispatcher->outputs[p], &span);
+		}
+		retval += reserved;
+		if (status != NULL)
+		{
+			for (size_t i = start; i < end; i++)
+			{
+				status[dispatcher->order[i]] = (i < (start + reserved)) ? CB_true : CB_false;
+			}
+		}
+		if ((reserved < (end - start)) && (dispatcher->nbPressured < dispatcher->nbOutputs))
+		{
+			size_t k = 0;
+			while ((k < dispatcher->nbPressured) && (dispatcher->pressured[k] != p))
+			{
+				k++;
+			}
+			if (k == dispatcher->nbPressured)
+			{
+				dispatcher->pressured[dispatcher->nbPressured++] = p;
+			}
+		}
+		start = end;
+	}
+	return retval;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBDispatcher_t *emCircularDispatchInit(CBuffer_t *const *outputs, const size_t nbOutputs, const size_t elemSize,
+									   CBKeyExtractor_t key, void *keyArg, const size_t maxBatch)
+{
+	if ((outputs == NULL) || (nbOutputs < 1) || (elemSize < 1) || (key == NULL) || (maxBatch < 1))
+		return NULL;
+	for (size_t p = 0; p < nbOutputs; p++)
+	{
+		if ((outputs[p] == NULL) || (outputs[p]->elemSize != elemSize))
+		{
+			CB_DEBUG_Print("CB Error:\tThe output %zu has not elements of %zu bytes!\r\n", p, elemSize);
+			return NULL;
+		}
+	}
+	CBDispatcher_t *retval = (CBDispatcher_t *)emCircularPortMalloc(sizeof(CBDispatcher_t));
+	if (retval == NULL)
+		return NULL;
+	retval->outputs = (CBuffer_t **)emCircularPortMalloc(nbOutputs * sizeof(CBuffer_t *));
+	retval->partitions = (size_t *)emCircularPortMalloc(maxBatch * sizeof(size_t));
+	retval->order = (size_t *)emCircularPortMalloc(maxBatch * sizeof(size_t));
+	retval->counts = (size_t *)emCircularPortMalloc(nbOutputs * sizeof(size_t));
+	retval->pressured = (size_t *)emCircularPortMalloc(nbOutputs * sizeof(size_t));
+	if ((retval->outputs == NULL) || (retval->partitions == NULL) || (retval->order == NULL) ||
+		(retval->counts == NULL) || (retval->pressured == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the dispatcher!\r\n");
+		emCircularDispatchDelete(retval);
+		return NULL;
+	}
+	memcpy(retval->outputs, outputs, nbOutputs * sizeof(CBuffer_t *));
+	retval->nbOutputs = nbOutputs;
+	retval->elemSize = elemSize;
+	retval->key = key;
+	retval->keyArg = keyArg;
+	retval->maxBatch = maxBatch;
+	retval->nbPressured = 0;
+	CB_DEBUG_Print("CB:\tDispatcher initialised. Dispatcher pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularDispatchDelete(CBDispatcher_t *dispatcher)
+{
+	if (dispatcher == NULL)
+		return CB_error;
+	if (dispatcher->outputs != NULL)
+		emCircularPortFree(dispatcher->outputs);
+	if (dispatcher->partitions != NULL)
+		emCircularPortFree(dispatcher->partitions);
+	if (dispatcher->order != NULL)
+		emCircularPortFree(dispatcher->order);
+	if (dispatcher->counts != NULL)
+		emCircularPortFree(dispatcher->counts);
+	if (dispatcher->pressured != NULL)
+		emCircularPortFree(dispatcher->pressured);
+	emCircularPortFree(dispatcher);
+	return CB_true;
+}
+
+size_t emCircularDispatchPartition(const CBDispatcher_t *dispatcher, const void *elem)
+{
+	if ((dispatcher == NULL) || (elem == NULL))
+		return 0;
+	uint64_t hash = emCircularDispatchMix(dispatcher->key(elem, dispatcher->keyArg));
+	return (size_t)(hash % dispatcher->nbOutputs);
+}
+
+size_t emCircularDispatch(CBDispatcher_t *dispatcher, const void *elems, const size_t nbElems, CBStatus_t *status)
+{
+	if ((dispatcher == NULL) || (elems == NULL))
+		return 0;
+	const unsigned char *ptr = (const unsigned char *)elems;
+	size_t retval = 0;
+	dispatcher->nbPressured = 0;
+	for (size_t done = 0; done < nbElems; done += dispatcher->maxBatch)
+	{
+		size_t chunk = nbElems - done;
+		if (chunk > dispatcher->maxBatch)
+		{
+			chunk = dispatcher->maxBatch;
+		}
+		retval += emCircularDispatchChunk(dispatcher, ptr + (done * dispatcher->elemSize), chunk,
+										  (status != NULL) ? &status[done] : NULL);
+	}
+	return retval;
+}
+
+size_t emCircularDispatchGetPressured(const CBDispatcher_t *dispatcher, size_t *outputs, const size_t maxOutputs)
+{
+	if (dispatcher == NULL)
+		return 0;
+	for (size_t i = 0; (outputs != NULL) && (i < dispatcher->nbPressured) && (i < maxOutputs); i++)
+	{
+		outputs[i] = dispatcher->pressured[i];
+	}
+	return dispatcher->nbPressured;
+}
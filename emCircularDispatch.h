@@ -0,0 +1,117 @@
+/*
+ * @file emCircularDispatch.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a dispatcher that partitions batches of elements
+ * in N circular buffers by the hash of their key.
+ *
+ * All the elements with the same key go in the same output buffer, so they keep
+ * their order and are served by a single consumer. A batch is first grouped by
+ * output with a counting sort, then every output is reserved with a single
+ * emCircularGetHeadBatch(), so every buffer is locked once per batch.
+ * The outputs that could not take all their elements are reported, so the
+ * caller can apply back-pressure.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARDISPATCH_H_
+#define EMCIRCULARDISPATCH_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the dispatcher data type
+ */
+typedef struct CBDispatcher_t
+{
+	CBuffer_t **outputs;		// output buffers
+	size_t nbOutputs;			// number of output buffers
+	size_t elemSize;			// size of the elements, the same of the output buffers
+	CBKeyExtractor_t key;		// function that reads the key of an element
+	void *keyArg;				// user argument of the key function
+	size_t maxBatch;			// maximum number of elements grouped at once
+	size_t *partitions;			// output of every element of the batch
+	size_t *order;				// elements of the batch grouped by output
+	size_t *counts;				// number of elements of the batch for every output
+	size_t *pressured;			// outputs that were full in the last dispatch
+	size_t nbPressured;			// number of outputs in pressured
+} CBDispatcher_t;
+
+/*
+ * @brief This function initializes the dispatcher.
+ *
+ * @param outputs, array of the output buffers, copied in the dispatcher.
+ * 		All the buffers must have elements of elemSize bytes, otherwise
+ * 		the dispatcher is not created
+ * @param nbOutputs, number of output buffers
+ * @param elemSize, size of every element in terms of bytes
+ * @param key, function that reads the key of an element
+ * @param keyArg, user argument passed to the key function
+ * @param maxBatch, maximum number of elements grouped at once. Bigger
+ * 		batches are dispatched in chunks of maxBatch elements
+ * @return CBDispatcher_t*, pointer to the dispatcher created. Returns
+ * 		NULL if it was not possible to create the dispatcher
+ */
+CBDispatcher_t *emCircularDispatchInit(CBuffer_t *const *outputs, const size_t nbOutputs, const size_t elemSize,
+									   CBKeyExtractor_t key, void *keyArg, const size_t maxBatch);
+
+/*
+ * @brief This function deletes the dispatcher. The output buffers are not deleted.
+ *
+ * @param dispatcher, pointer to the dispatcher to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularDispatchDelete(CBDispatcher_t *dispatcher);
+
+/*
+ * @brief This function returns the output of an element: the key is mixed
+ * 		with a 64-bit finalizer, so consecutive keys are spread on all the outputs.
+ *
+ * @param dispatcher, pointer to the dispatcher to be used
+ * @param elem, pointer to the element
+ * @return size_t, index of the output buffer of the element
+ */
+size_t emCircularDispatchPartition(const CBDispatcher_t *dispatcher, const void *elem);
+
+/*
+ * @brief This function copies a batch of elements in their output buffers.
+ * 		The elements of the same output keep the order of the batch.
+ * 		It must not be called by more threads at the same time.
+ *
+ * @param dispatcher, pointer to the dispatcher to be used
+ * @param elems, array of nbElems contiguous elements
+ * @param nbElems, number of elements of the batch
+ * @param status, array filled with CB_true for every element dispatched and
+ * 		CB_false for every element dropped because its output was full. Can be NULL
+ * @return size_t, number of elements dispatched
+ */
+size_t emCircularDispatch(CBDispatcher_t *dispatcher, const void *elems, const size_t nbElems, CBStatus_t *status);
+
+/*
+ * @brief This function returns the outputs that could not take all their
+ * 		elements in the last call of emCircularDispatch().
+ *
+ * @param dispatcher, pointer to the dispatcher to be used
+ * @param outputs, filled with the indexes of the outputs full. Can be NULL
+ * @param maxOutputs, size of outputs
+ * @return size_t, number of outputs full, also beyond maxOutputs
+ */
+size_t emCircularDispatchGetPressured(const CBDispatcher_t *dispatcher, size_t *outputs, const size_t maxOutputs);
+
+#endif /* EMCIRCULARDISPATCH_H_ */
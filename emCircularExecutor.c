@@ -0,0 +1,316 @@
+/*
+ * @file emCircularExecutor.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_attr_setaffinity_np
+#endif
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "emCircularExecutor.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Parks the calling thread while *word is equal to value
+ */
+static void emCircularExecutorFutexWait(uint32_t *word, const uint32_t value)
+{
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+/*
+ * Wakes a worker if it is parked. The fence pairs with the one of the worker
+ * between setting its parked flag and checking its buffer, so either the worker
+ * sees the new task or the submitter sees the worker parked.
+ */
+static int emCircularExecutorWake(CBWorker_t *worker)
+{
+	emCircularPort_AtomicFence();
+	if (emCircularPort_AtomicLoad(&worker->parked) == 0)
+		return 0;
+	emCircularPort_AtomicStore(&worker->parked, 0);
+	syscall(SYS_futex, &worker->parked, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	return 1;
+}
+
+/*
+ * Copies the tail task of a worker buffer in task. Must be called with the worker lock.
+ */
+static int emCircularExecutorTakeUnlocked(CBWorker_t *worker, unsigned char *task, const size_t taskSize)
+{
+	void *tail = emCircularPeekTail(worker->ring, NULL);
+	if (tail == NULL)
+		return 0;
+	memcpy(task, tail, taskSize);
+	emCircularGetTail(worker->ring);
+	return 1;
+}
+
+/*
+ * Takes a task from the buffer of the worker or, if it is empty, steals
+ * one from the other workers
+ */
+static int emCircularExecutorTake(CBExecutor_t *executor, CBWorker_t *self)
+{
+	int retval = 0;
+	if (emCircularIsEmpty(self->ring) == CB_false)
+	{
+		pthread_mutex_lock(&self->lock);
+		retval = emCircularExecutorTakeUnlocked(self, self->task, executor->taskSize);
+		pthread_mutex_unlock(&self->lock);
+		if (retval)
+			return retval;
+	}
+	for (size_t i = 1; i < executor->nbWorkers; i++)
+	{
+		CBWorker_t *victim = &executor->workers[(self->index + i) % executor->nbWorkers];
+		if (emCircularIsEmpty(victim->ring) != CB_false)
+			continue;
+		if (pthread_mutex_trylock(&victim->lock) != 0)
+			continue;
+		retval = emCircularExecutorTakeUnlocked(victim, self->task, executor->taskSize);
+		pthread_mutex_unlock(&victim->lock);
+		if (retval)
+			return retval;
+	}
+	return 0;
+}
+
+/*
+ * Body of the worker threads
+ */
+static void *emCircularExecutorWorker(void *arg)
+{
+	CBWorker_t *self = (CBWorker_t *)arg;
+	CBExecutor_t *executor = self->executor;
+	size_t idle = 0;
+	for (;;)
+	{
+		if (emCircularExecutorTake(executor, self))
+		{
+			CBTask_t *task = (CBTask_t *)self->task;
+			task->fn(task->payload);
+			idle = 0;
+			continue;
+		}
+		if (emCircularPort_AtomicLoad(&executor->stop))
+			break;
+		if (++idle < CB_EXECUTOR_SPIN)
+		{
+			emCircularPort_CpuRelax();
+			continue;
+		}
+		emCircularPort_AtomicStore(&self->parked, 1);
+		emCircularPort_AtomicFence();
+		if ((emCircularIsEmpty(self->ring) == CB_true) && (!emCircularPort_AtomicLoad(&executor->stop)))
+		{
+			emCircularExecutorFutexWait(&self->parked, 1);
+		}
+		emCircularPort_AtomicStore(&self->parked, 0);
+		idle = 0;
+	}
+	return NULL;
+}
+
+/*
+ * Pushes up to nbTasks tasks in the buffer of a worker, locking it once.
+ * Returns the number of tasks pushed.
+ */
+static size_t emCircularExecutorPush(CBExecutor_t *executor, CBWorker_t *worker, CBTaskFn_t fn,
+									 const unsigned char *payloads, const size_t nbTasks)
+{
+	size_t retval = 0;
+	pthread_mutex_lock(&worker->lock);
+	while (retval < nbTasks)
+	{
+		CBTask_t *task = (CBTask_t *)emCircularGetHead(worker->ring);
+		if (task == NULL)
+			break;
+		task->fn = fn;
+		if (payloads != NULL)
+		{
+			memcpy(task->payload, payloads + (retval * executor->payloadSize), executor->payloadSize);
+		}
+		retval++;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	if (retval > 0)
+	{
+		/* A busy worker cannot take the task soon: wake its neighbour to steal it */
+		if (!emCircularExecutorWake(worker))
+		{
+			emCircularExecutorWake(&executor->workers[(worker->index + 1) % executor->nbWorkers]);
+		}
+	}
+	return retval;
+}
+
+/*
+ * Stops and joins the first nbStarted workers, then frees the executor
+ */
+static void emCircularExecutorFree(CBExecutor_t *executor, const size_t nbStarted)
+{
+	emCircularPort_AtomicStore(&executor->stop, 1);
+	for (size_t i = 0; i < nbStarted; i++)
+	{
+		emCircularExecutorWake(&executor->workers[i]);
+	}
+	for (size_t i = 0; i < nbStarted; i++)
+	{
+		pthread_join(executor->workers[i].thread, NULL);
+	}
+	for (size_t i = 0; i < executor->nbWorkers; i++)
+	{
+		CBWorker_t *worker = &executor->workers[i];
+		if (worker->ring != NULL)
+		{
+			emCircularDelete(worker->ring);
+		}
+		if (worker->task != NULL)
+		{
+			emCircularPortFree(worker->task);
+		}
+		pthread_mutex_destroy(&worker->lock);
+	}
+	emCircularPortFree(executor->workers);
+	emCircularPortFree(executor);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBExecutor_t *emCircularExecutorInit(const size_t nbWorkers, const size_t queueElems, const size_t payloadSize,
+									 const int pinCpus)
+{
+	if ((nbWorkers < 1) || (queueElems < 1))
+		return NULL;
+	CBExecutor_t *retval = (CBExecutor_t *)emCircularPortMalloc(sizeof(CBExecutor_t));
+	if (retval == NULL)
+		return NULL;
+	retval->workers = (CBWorker_t *)emCircularPortMalloc(nbWorkers * sizeof(CBWorker_t));
+	if (retval->workers == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	memset(retval->workers, 0, nbWorkers * sizeof(CBWorker_t));
+	retval->nbWorkers = nbWorkers;
+	retval->payloadSize = payloadSize;
+	retval->taskSize = sizeof(CBTask_t) + payloadSize;
+	retval->taskSize = (retval->taskSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	retval->nextWorker = 0;
+	retval->stop = 0;
+	/* All the locks are initialised first, the free path destroys all of them */
+	for (size_t i = 0; i < nbWorkers; i++)
+	{
+		CBWorker_t *worker = &retval->workers[i];
+		pthread_mutex_init(&worker->lock, NULL);
+		worker->executor = retval;
+		worker->index = i;
+	}
+	for (size_t i = 0; i < nbWorkers; i++)
+	{
+		CBWorker_t *worker = &retval->workers[i];
+		worker->ring = emCircularInit(queueElems + 1, retval->taskSize, NULL);
+		worker->task = (unsigned char *)emCircularPortMalloc(retval->taskSize);
+		if ((worker->ring == NULL) || (worker->task == NULL))
+		{
+			emCircularExecutorFree(retval, 0);
+			return NULL;
+		}
+	}
+	long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	for (size_t i = 0; i < nbWorkers; i++)
+	{
+		CBWorker_t *worker = &retval->workers[i];
+		pthread_attr_t attr;
+		int thread_retval = pthread_attr_init(&attr);
+		if (thread_retval == 0)
+		{
+			/* The worker is pinned before it starts, so it touches its buffer only from its cpu */
+			if (pinCpus && (nbCpus > 0))
+			{
+				cpu_set_t cpus;
+				CPU_ZERO(&cpus);
+				CPU_SET(i % (size_t)nbCpus, &cpus);
+				thread_retval = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+			}
+			if (thread_retval == 0)
+			{
+				thread_retval = pthread_create(&worker->thread, &attr, emCircularExecutorWorker, worker);
+			}
+			pthread_attr_destroy(&attr);
+		}
+		if (thread_retval != 0)
+		{
+			CB_DEBUG_Print("CB Error:\tCannot start the executor workers!\r\n");
+			emCircularExecutorFree(retval, i);
+			return NULL;
+		}
+	}
+	CB_DEBUG_Print("CB:\tExecutor initialised. Executor pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularExecutorDelete(CBExecutor_t *executor)
+{
+	if (executor == NULL)
+		return CB_error;
+	emCircularExecutorFree(executor, executor->nbWorkers);
+	return CB_true;
+}
+
+CBStatus_t emCircularExecutorSubmit(CBExecutor_t *executor, CBTaskFn_t fn, const void *payload)
+{
+	if ((executor == NULL) || (fn == NULL))
+		return CB_error;
+	return (emCircularExecutorSubmitBatch(executor, fn, payload, 1) == 1) ? CB_true : CB_false;
+}
+
+size_t emCircularExecutorSubmitBatch(CBExecutor_t *executor, CBTaskFn_t fn, const void *payloads,
+									 const size_t nbTasks)
+{
+	if ((executor == NULL) || (fn == NULL))
+		return 0;
+	const unsigned char *ptr = (const unsigned char *)payloads;
+	size_t retval = 0;
+	size_t first = emCircularPort_AtomicFetchAdd(&executor->nextWorker, 1);
+	for (size_t i = 0; (i < executor->nbWorkers) && (retval < nbTasks); i++)
+	{
+		CBWorker_t *worker = &executor->workers[(first + i) % executor->nbWorkers];
+		retval += emCircularExecutorPush(executor, worker, fn, (ptr != NULL) ? ptr + (retval * executor->payloadSize) : NULL,
+										 nbTasks - retval);
+	}
+	return retval;
+}
@@ -0,0 +1,136 @@
+/*
+ * @file emCircularExecutor.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a thread-pool executor built on emCircularBuffer.
+ *
+ * Every worker owns a circular buffer of task descriptors: a function pointer
+ * followed by an inline payload of configurable size, so submitting a task does
+ * not allocate memory. Idle workers steal tasks from the other workers and then
+ * park on a futex until a new task is submitted to them.
+ * The module needs Linux (pthread, futex).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULAREXECUTOR_H_
+#define EMCIRCULAREXECUTOR_H_
+
+#include <pthread.h>
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_EXECUTOR_SPIN 128 // Number of empty polls of an idle worker before parking
+
+/*
+ * Definition of the function executed by a task. It receives the
+ * pointer to a copy of the payload submitted with the task.
+ */
+typedef void (*CBTaskFn_t)(void *payload);
+
+/*
+ * Definition of the task descriptor stored in the buffers
+ */
+typedef struct CBTask_t
+{
+	CBTaskFn_t fn;			 // function to be executed
+	unsigned char payload[]; // inline payload of the task
+} CBTask_t;
+
+struct CBExecutor_t;
+
+/*
+ * Definition of the worker data type
+ */
+typedef struct CBWorker_t
+{
+	CBuffer_t *ring;			   // buffer of the tasks of the worker
+	pthread_mutex_t lock;		   // lock of the buffer, shared by submitters, owner and thieves
+	uint32_t parked;			   // futex word, 1 while the worker is parked
+	unsigned char *task;		   // copy of the task being executed
+	pthread_t thread;			   // thread of the worker
+	struct CBExecutor_t *executor; // executor that owns the worker
+	size_t index;				   // index of the worker in the executor
+} CBWorker_t;
+
+/*
+ * Definition of the executor data type
+ */
+typedef struct CBExecutor_t
+{
+	CBWorker_t *workers;		// workers of the executor
+	size_t nbWorkers;			// number of workers
+	size_t payloadSize;			// size in bytes of the payload of a task
+	size_t taskSize;			// size in bytes of a task descriptor
+	size_t nextWorker;			// worker that receives the next submission
+	int stop;					// set when the workers have to exit
+} CBExecutor_t;
+
+/*
+ * @brief This function initializes the executor and starts its workers.
+ *
+ * @param nbWorkers, number of worker threads
+ * @param queueElems, number of tasks of the buffer of every worker
+ * @param payloadSize, size in bytes of the inline payload of a task
+ * @param pinCpus, non zero to pin worker i on the cpu i modulo the number of cpus,
+ * 		before it starts
+ * @return CBExecutor_t*, pointer to the executor created. Returns
+ * 		NULL if it was not possible to create the executor or to pin its workers
+ */
+CBExecutor_t *emCircularExecutorInit(const size_t nbWorkers, const size_t queueElems, const size_t payloadSize,
+									 const int pinCpus);
+
+/*
+ * @brief This function stops the workers, after they execute all the tasks
+ * 		submitted, and frees all the memory dedicated to the executor.
+ *
+ * @param executor, pointer to the executor to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularExecutorDelete(CBExecutor_t *executor);
+
+/*
+ * @brief This function submits a task. The workers are chosen round-robin,
+ * 		a full worker buffer is skipped.
+ *
+ * @param executor, pointer to the executor to be used
+ * @param fn, function to be executed
+ * @param payload, pointer to the payload copied in the task. Can be NULL
+ * 		to leave the payload uninitialised
+ * @return CBStatus_t, return value. Returns CB_true if the task was submitted,
+ * 		CB_false if the buffers of all the workers are full
+ */
+CBStatus_t emCircularExecutorSubmit(CBExecutor_t *executor, CBTaskFn_t fn, const void *payload);
+
+/*
+ * @brief This function submits a batch of tasks executing the same function,
+ * 		locking a worker buffer once for all the tasks that fit in it.
+ *
+ * @param executor, pointer to the executor to be used
+ * @param fn, function to be executed
+ * @param payloads, array of nbTasks payloads of payloadSize bytes
+ * @param nbTasks, number of tasks to be submitted
+ * @return size_t, number of tasks submitted, lower than nbTasks if the
+ * 		buffers of all the workers are full
+ */
+size_t emCircularExecutorSubmitBatch(CBExecutor_t *executor, CBTaskFn_t fn, const void *payloads,
+									 const size_t nbTasks);
+
+#endif /* EMCIRCULAREXECUTOR_H_ */
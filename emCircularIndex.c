@@ -0,0 +1,222 @@
+/*
+ * @file emCircularIndex.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularIndex.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the home position of a key in the table, the key is mixed with
+ * the 64-bit finalizer of MurmurHash3
+ */
+static size_t emCircularIndexHome(const CBIndex_t *index, uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return (size_t)key & index->entryMask;
+}
+
+/*
+ * Returns the position of a key in the table, or the empty position
+ * where it would be inserted
+ */
+static size_t emCircularIndexFind(const CBIndex_t *index, const uint64_t key)
+{
+	size_t pos = emCircularIndexHome(index, key);
+	while ((index->entrySeqs[pos] != 0) && (index->entryKeys[pos] != key))
+	{
+		pos = (pos + 1) & index->entryMask;
+	}
+	return pos;
+}
+
+/*
+ * Empties a position of the table, moving back the following entries of
+ * the probe sequence so that no tombstone is needed
+ */
+static void emCircularIndexUnlink(CBIndex_t *index, size_t pos)
+{
+	size_t next = pos;
+	index->entrySeqs[pos] = 0;
+	for (;;)
+	{
+		next = (next + 1) & index->entryMask;
+		if (index->entrySeqs[next] == 0)
+			break;
+		size_t home = emCircularIndexHome(index, index->entryKeys[next]);
+		/* The entry stays if its home is cyclically in (pos, next] */
+		int stays = (pos <= next) ? ((pos < home) && (home <= next)) : ((pos < home) || (home <= next));
+		if (stays)
+			continue;
+		index->entryKeys[pos] = index->entryKeys[next];
+		index->entrySeqs[pos] = index->entrySeqs[next];
+		index->entrySeqs[next] = 0;
+		pos = next;
+	}
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBIndex_t *emCircularIndexInit(CBuffer_t *ring, CBKeyExtractor_t key, void *keyArg)
+{
+	if ((ring == NULL) || (key == NULL))
+		return NULL;
+	/* The table is kept at most half full, so the probe sequences stay short */
+	size_t tableSize = 2;
+	while (tableSize < (2 * ring->maxElems))
+	{
+		tableSize *= 2;
+	}
+	CBIndex_t *retval = (CBIndex_t *)emCircularPortMalloc(sizeof(CBIndex_t));
+	if (retval == NULL)
+		return NULL;
+	retval->slotKeys = (uint64_t *)emCircularPortMalloc(ring->maxElems * sizeof(uint64_t));
+	retval->entryKeys = (uint64_t *)emCircularPortMalloc(tableSize * sizeof(uint64_t));
+	retval->entrySeqs = (uint64_t *)emCircularPortMalloc(tableSize * sizeof(uint64_t));
+	if ((retval->slotKeys == NULL) || (retval->entryKeys == NULL) || (retval->entrySeqs == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the index!\r\n");
+		emCircularIndexDelete(retval);
+		return NULL;
+	}
+	memset(retval->entrySeqs, 0, tableSize * sizeof(uint64_t));
+	retval->ring = ring;
+	retval->key = key;
+	retval->keyArg = keyArg;
+	retval->entryMask = tableSize - 1;
+	retval->rewinds = emCircularPort_AtomicLoad(&ring->rewinds);
+	retval->indexedSeq = emCircularGetTailSeq(ring);
+	retval->releasedSeq = retval->indexedSeq;
+	emCircularIndexSync(retval);
+	CB_DEBUG_Print("CB:\tIndex initialised. Index pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularIndexDelete(CBIndex_t *index)
+{
+	if (index == NULL)
+		return CB_error;
+	if (index->slotKeys != NULL)
+		emCircularPortFree(index->slotKeys);
+	if (index->entryKeys != NULL)
+		emCircularPortFree(index->entryKeys);
+	if (index->entrySeqs != NULL)
+		emCircularPortFree(index->entrySeqs);
+	emCircularPortFree(index);
+	return CB_true;
+}
+
+size_t emCircularIndexSync(CBIndex_t *index)
+{
+	if (index == NULL)
+		return 0;
+	size_t maxElems = index->ring->maxElems;
+	uint64_t rewinds = emCircularPort_AtomicLoad(&index->ring->rewinds);
+	uint64_t pendingSeq = emCircularPort_AtomicLoad(&index->ring->pendingSeq);
+	uint64_t tailSeq = emCircularGetTailSeq(index->ring);
+	uint64_t headSeq = emCircularGetHeadSeq(index->ring);
+	if (headSeq > pendingSeq)
+	{
+		headSeq = pendingSeq;
+	}
+
+	/* The elements behind the indexed ones changed, the table is rebuilt from the tail */
+	if (rewinds != index->rewinds)
+	{
+		memset(index->entrySeqs, 0, (index->entryMask + 1) * sizeof(uint64_t));
+		index->rewinds = rewinds;
+		index->indexedSeq = tailSeq;
+		index->releasedSeq = tailSeq;
+	}
+
+	/* The released elements are removed first, their slots can be reused by the new ones */
+	uint64_t releasedEnd = (tailSeq < index->indexedSeq) ? tailSeq : index->indexedSeq;
+	for (; index->releasedSeq < releasedEnd; index->releasedSeq++)
+	{
+		uint64_t seq = index->releasedSeq;
+		size_t pos = emCircularIndexFind(index, index->slotKeys[seq % maxElems]);
+		/* A newer element with the same key keeps the entry */
+		if (index->entrySeqs[pos] == (seq + 1))
+		{
+			emCircularIndexUnlink(index, pos);
+		}
+	}
+	if (index->releasedSeq < tailSeq)
+	{
+		index->releasedSeq = tailSeq;
+	}
+	if (index->indexedSeq < tailSeq)
+	{
+		index->indexedSeq = tailSeq;
+	}
+
+	size_t retval = 0;
+	for (; index->indexedSeq < headSeq; index->indexedSeq++)
+	{
+		uint64_t seq = index->indexedSeq;
+		const void *elem = emCircularPeekSeq(index->ring, seq);
+		if (elem == NULL)
+			break;
+		uint64_t key = index->key(elem, index->keyArg);
+		index->slotKeys[seq % maxElems] = key;
+		size_t pos = emCircularIndexFind(index, key);
+		index->entryKeys[pos] = key;
+		index->entrySeqs[pos] = seq + 1;
+		retval++;
+	}
+	return retval;
+}
+
+void *emCircularIndexLookup(CBIndex_t *index, const uint64_t key, uint64_t *seq)
+{
+	if (index == NULL)
+		return NULL;
+	emCircularIndexSync(index);
+	size_t pos = emCircularIndexFind(index, key);
+	if (index->entrySeqs[pos] == 0)
+		return NULL;
+	uint64_t entrySeq = index->entrySeqs[pos] - 1;
+	void *retval = emCircularPeekSeq(index->ring, entrySeq);
+	/* The element is checked again, it can be released after the sync */
+	if ((retval == NULL) || (entrySeq < emCircularGetTailSeq(index->ring)) ||
+		(index->key(retval, index->keyArg) != key))
+		return NULL;
+	if (seq != NULL)
+	{
+		*seq = entrySeq;
+	}
+	return retval;
+}
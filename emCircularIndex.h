@@ -0,0 +1,106 @@
+/*
+ * @file emCircularIndex.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a hash index of the keys of the elements
+ * resident in a circular buffer.
+ *
+ * The index maps the key of every element, read with a user function, to the
+ * sequence number of the newest element with that key, so the elements still in
+ * the buffer can be looked up or deduplicated in O(1). The index is updated lazily:
+ * on every lookup (or explicit sync) the elements pushed since the last update are
+ * added and the ones released are removed, using the copy of their key kept for
+ * every slot, since their memory can be already reused. Every lookup is validated
+ * on the element found, so it never returns an element released or replaced.
+ * An element obtained with emCircularGetHead() is visible before it is written,
+ * so it is indexed only once a later element is pushed: the producer must write
+ * every element before it pushes the next one. The elements pushed with
+ * emCircularReserveHeadBatch()/emCircularCommitHeadBatch() or emCircularTransfer()
+ * are indexed at once. When the head or the tail of the buffer moves back
+ * (emCircularUnpush(), emCircularGetHeadFront(), emCircularRewind()) the index
+ * is rebuilt on the next sync.
+ * The index must be used by the consumer thread, or the buffer must use the
+ * locking mechanism.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARINDEX_H_
+#define EMCIRCULARINDEX_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the index data type
+ */
+typedef struct CBIndex_t
+{
+	CBuffer_t *ring;			// buffer indexed
+	CBKeyExtractor_t key;		// function that reads the key of an element
+	void *keyArg;				// user argument of the key function
+	uint64_t *slotKeys;			// key of the element indexed in every slot of the buffer
+	uint64_t *entryKeys;		// open addressing table, keys
+	uint64_t *entrySeqs;		// open addressing table, sequence number + 1 or 0 if empty
+	size_t entryMask;			// size of the table minus one, the size is a power of two
+	uint64_t indexedSeq;		// sequence number of the next element to be indexed
+	uint64_t releasedSeq;		// sequence number of the next element to be removed
+	uint64_t rewinds;			// rewinds of the buffer seen by the last sync
+} CBIndex_t;
+
+/*
+ * @brief This function initializes the index and adds the elements
+ * 		already in the buffer.
+ *
+ * @param ring, pointer to the circular buffer to be indexed
+ * @param key, function that reads the key of an element
+ * @param keyArg, user argument passed to the key function
+ * @return CBIndex_t*, pointer to the index created. Returns
+ * 		NULL if it was not possible to create the index
+ */
+CBIndex_t *emCircularIndexInit(CBuffer_t *ring, CBKeyExtractor_t key, void *keyArg);
+
+/*
+ * @brief This function deletes the index. The buffer is not deleted.
+ *
+ * @param index, pointer to the index to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularIndexDelete(CBIndex_t *index);
+
+/*
+ * @brief This function removes from the index the elements released by the
+ * 		buffer and adds the elements written since the last update.
+ * 		It is called by emCircularIndexLookup().
+ *
+ * @param index, pointer to the index to be updated
+ * @return size_t, number of elements added
+ */
+size_t emCircularIndexSync(CBIndex_t *index);
+
+/*
+ * @brief This function finds the newest element of the buffer with a key.
+ *
+ * @param index, pointer to the index to be used
+ * @param key, key to be found
+ * @param seq, pointer where the sequence number of the element is stored. Can be NULL
+ * @return void*, pointer to the element in the buffer. Returns NULL if no
+ * 		element of the buffer has the key
+ */
+void *emCircularIndexLookup(CBIndex_t *index, const uint64_t key, uint64_t *seq);
+
+#endif /* EMCIRCULARINDEX_H_ */
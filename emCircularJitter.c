@@ -0,0 +1,224 @@
+/*
+ * @file emCircularJitter.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularJitter.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Updates the jitter estimate with the transit time of a frame (RFC 3550, 6.4.1)
+ * and moves the depth toward its target
+ */
+static void emCircularJitterAdapt(CBJitter_t *jitter, const int64_t transit)
+{
+	int64_t d = transit - jitter->lastTransit;
+	uint64_t absD = (d < 0) ? (uint64_t)(-d) : (uint64_t)d;
+	jitter->lastTransit = transit;
+	if (absD >= jitter->jitter)
+	{
+		jitter->jitter += (absD - jitter->jitter) / 16;
+	}
+	else
+	{
+		jitter->jitter -= (jitter->jitter - absD) / 16;
+	}
+
+	uint64_t target = jitter->jitter * CB_JITTER_FACTOR;
+	if (target < jitter->minDepth)
+	{
+		target = jitter->minDepth;
+	}
+	if (target > jitter->maxDepth)
+	{
+		target = jitter->maxDepth;
+	}
+	uint64_t step = jitter->frameDuration / CB_JITTER_STEP_DIV;
+	if (step < 1)
+	{
+		step = 1;
+	}
+	uint64_t delta = (target > jitter->depth) ? (target - jitter->depth) : (jitter->depth - target);
+	if (delta > step)
+	{
+		delta = step;
+	}
+	if (target > jitter->depth)
+	{
+		jitter->depth += delta;
+		jitter->offset += (int64_t)delta;
+	}
+	else
+	{
+		jitter->depth -= delta;
+		jitter->offset -= (int64_t)delta;
+	}
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBJitter_t *emCircularJitterInit(const size_t capacity, const size_t frameSize, const uint64_t frameDuration,
+								 const uint64_t minDepth, const uint64_t maxDepth)
+{
+	if ((frameSize < 1) || (frameDuration < 1) || (maxDepth < minDepth))
+		return NULL;
+	CBJitter_t *retval = (CBJitter_t *)emCircularPortMalloc(sizeof(CBJitter_t));
+	if (retval == NULL)
+		return NULL;
+	memset(retval, 0, sizeof(CBJitter_t));
+	retval->reorder = emCircularReorderInit(capacity, sizeof(CBJitterHeader_t) + frameSize, 0);
+	retval->playFrame = (unsigned char *)emCircularPortMalloc(frameSize);
+	if ((retval->reorder == NULL) || (retval->playFrame == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the jitter buffer!\r\n");
+		emCircularJitterDelete(retval);
+		return NULL;
+	}
+	retval->frameSize = frameSize;
+	retval->frameDuration = frameDuration;
+	retval->minDepth = minDepth;
+	retval->maxDepth = maxDepth;
+	retval->depth = minDepth;
+	CB_DEBUG_Print("CB:\tJitter buffer initialised. Buffer pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularJitterDelete(CBJitter_t *jitter)
+{
+	if (jitter == NULL)
+		return CB_error;
+	if (jitter->reorder != NULL)
+		emCircularReorderDelete(jitter->reorder);
+	if (jitter->playFrame != NULL)
+		emCircularPortFree(jitter->playFrame);
+	emCircularPortFree(jitter);
+	return CB_true;
+}
+
+CBStatus_t emCircularJitterSetHooks(CBJitter_t *jitter, CBJitterLateFn_t lateFn, CBJitterGapFn_t gapFn, void *arg)
+{
+	if (jitter == NULL)
+		return CB_error;
+	jitter->lateFn = lateFn;
+	jitter->gapFn = gapFn;
+	jitter->hookArg = arg;
+	return CB_true;
+}
+
+CBStatus_t emCircularJitterInsert(CBJitter_t *jitter, const uint64_t seq, const uint64_t timestamp,
+								  const void *frame, const uint64_t now)
+{
+	if ((jitter == NULL) || (frame == NULL))
+		return CB_error;
+	if (emCircularPort_AtomicLoad(&jitter->started) == 0)
+	{
+		/* The player does not touch the reorder buffer before started is set */
+		emCircularReorderSkip(jitter->reorder, seq);
+		emCircularPort_AtomicStore(&jitter->started, 1);
+	}
+	CBStatus_t retval = CB_false;
+	if (seq >= emCircularReorderGetNextSeq(jitter->reorder))
+	{
+		CBJitterHeader_t header;
+		header.timestamp = timestamp;
+		header.arrival = now;
+		retval = emCircularReorderInsertParts(jitter->reorder, seq, &header, sizeof(header), frame);
+	}
+	/* The frame can also become late while it is inserted, when its deadline expires */
+	if ((retval != CB_true) && (seq < emCircularReorderGetNextSeq(jitter->reorder)))
+	{
+		CB_DEBUG_Print("CB:\tLate frame dropped.\r\n");
+		if (jitter->lateFn != NULL)
+		{
+			jitter->lateFn(jitter, seq, frame, jitter->hookArg);
+		}
+	}
+	return retval;
+}
+
+void *emCircularJitterGetFrame(CBJitter_t *jitter, const uint64_t now, uint64_t *seq)
+{
+	if ((jitter == NULL) || (emCircularPort_AtomicLoad(&jitter->started) == 0))
+		return NULL;
+	uint64_t nextSeq;
+	unsigned char *elem = (unsigned char *)emCircularReorderPeekTail(jitter->reorder, &nextSeq);
+	if (elem != NULL)
+	{
+		CBJitterHeader_t header;
+		memcpy(&header, elem, sizeof(header));
+		int64_t transit = (int64_t)(header.arrival - header.timestamp);
+		if (!jitter->timed)
+		{
+			jitter->offset = transit + (int64_t)jitter->depth;
+			jitter->lastTransit = transit;
+			jitter->timed = 1;
+		}
+		uint64_t playout = header.timestamp + (uint64_t)jitter->offset;
+		if ((int64_t)(now - playout) < 0)
+			return NULL;
+		emCircularJitterAdapt(jitter, transit);
+		jitter->lastPlayout = playout;
+		/* The slot is released, the receiver can write the frame capacity frames later in it */
+		memcpy(jitter->playFrame, elem + sizeof(CBJitterHeader_t), jitter->frameSize);
+		emCircularReorderGetTail(jitter->reorder, NULL);
+		if (seq != NULL)
+		{
+			*seq = nextSeq;
+		}
+		return jitter->playFrame;
+	}
+
+	/* The next frame is missing: it is due one frame after the last one played */
+	if (!jitter->timed)
+		return NULL;
+	uint64_t playout = jitter->lastPlayout + jitter->frameDuration;
+	if ((int64_t)(now - playout) < 0)
+		return NULL;
+	nextSeq = emCircularReorderGetNextSeq(jitter->reorder);
+	emCircularReorderSkip(jitter->reorder, nextSeq + 1);
+	jitter->lastPlayout = playout;
+	CB_DEBUG_Print("CB:\tMissing frame due.\r\n");
+	if ((jitter->gapFn == NULL) || (jitter->gapFn(jitter, nextSeq, jitter->playFrame, jitter->hookArg) != CB_true))
+		return NULL;
+	if (seq != NULL)
+	{
+		*seq = nextSeq;
+	}
+	return jitter->playFrame;
+}
+
+uint64_t emCircularJitterGetDepth(const CBJitter_t *jitter)
+{
+	if (jitter == NULL)
+		return 0;
+	return jitter->depth;
+}
@@ -0,0 +1,164 @@
+/*
+ * @file emCircularJitter.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a jitter buffer for timestamped frames built
+ * on the reorder buffer of emCircularReorder.h.
+ *
+ * The receiver inserts the frames with their sequence number, media timestamp
+ * and arrival time; the player asks for the frame due at the current time, that
+ * is found in O(1) at the start of the reorder window. Every frame is played at
+ * its timestamp plus a playout offset, that includes a depth adapted to the
+ * interarrival jitter estimated as in RFC 3550. Frames received after their
+ * sequence number was played are given to a late hook, missing frames that are
+ * due can be concealed by a gap hook.
+ * All the times (timestamps, arrival times, now) must use the same unit.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARJITTER_H_
+#define EMCIRCULARJITTER_H_
+
+#include "emCircularReorder.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_JITTER_FACTOR 4		// target depth in multiples of the jitter estimate
+#define CB_JITTER_STEP_DIV 8	// the depth changes by at most frameDuration / CB_JITTER_STEP_DIV per frame
+
+/*
+ * Definition of the header stored before every frame in the reorder buffer
+ */
+typedef struct CBJitterHeader_t
+{
+	uint64_t timestamp;		// media timestamp of the frame
+	uint64_t arrival;		// arrival time of the frame
+} CBJitterHeader_t;
+
+struct CBJitter_t;
+
+/*
+ * Definition of the hook called on a frame received after its sequence number was played.
+ * It is called by the thread inserting the frame.
+ */
+typedef void (*CBJitterLateFn_t)(struct CBJitter_t *jitter, uint64_t seq, const void *frame, void *arg);
+
+/*
+ * Definition of the hook called when a missing frame is due. It can write a
+ * concealment frame in frame and return CB_true to play it, or CB_false to skip it.
+ */
+typedef CBStatus_t (*CBJitterGapFn_t)(struct CBJitter_t *jitter, uint64_t seq, void *frame, void *arg);
+
+/*
+ * Definition of the jitter buffer data type
+ */
+typedef struct CBJitter_t
+{
+	CBReorder_t *reorder;		// frames with their header, ordered by sequence number
+	size_t frameSize;			// size in bytes of a frame
+	uint64_t frameDuration;		// nominal duration of a frame
+	uint64_t minDepth;			// minimum playout depth
+	uint64_t maxDepth;			// maximum playout depth
+	uint64_t depth;				// current playout depth
+	uint64_t jitter;			// interarrival jitter estimate
+	int64_t offset;				// playout time minus media timestamp
+	int64_t lastTransit;		// arrival time minus timestamp of the last frame played
+	uint64_t lastPlayout;		// playout time of the last frame played or concealed
+	int started;				// set when the first frame is inserted
+	int timed;					// set when the playout offset is known
+	CBJitterLateFn_t lateFn;	// late hook, can be NULL
+	CBJitterGapFn_t gapFn;		// gap hook, can be NULL
+	void *hookArg;				// user argument of the hooks
+	unsigned char *playFrame;	// copy of the frame returned to the player
+} CBJitter_t;
+
+/*
+ * @brief This function initializes the jitter buffer.
+ *
+ * @param capacity, number of frames of the reorder window. Must be a power
+ * 		of two, not lower than 64
+ * @param frameSize, size of every frame in terms of bytes
+ * @param frameDuration, nominal duration of a frame, used to schedule the missing frames
+ * @param minDepth, minimum playout depth
+ * @param maxDepth, maximum playout depth. Must not be lower than minDepth
+ * @return CBJitter_t*, pointer to the jitter buffer created. Returns
+ * 		NULL if it was not possible to create the jitter buffer
+ */
+CBJitter_t *emCircularJitterInit(const size_t capacity, const size_t frameSize, const uint64_t frameDuration,
+								 const uint64_t minDepth, const uint64_t maxDepth);
+
+/*
+ * @brief This function deletes the jitter buffer and frees its memory.
+ *
+ * @param jitter, pointer to the jitter buffer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularJitterDelete(CBJitter_t *jitter);
+
+/*
+ * @brief This function configures the late and gap hooks.
+ * 		It must be called before the frames are inserted.
+ *
+ * @param jitter, pointer to the jitter buffer to be configured
+ * @param lateFn, hook called on the late frames. Can be NULL
+ * @param gapFn, hook called on the missing frames due. Can be NULL
+ * @param arg, user argument passed to the hooks
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularJitterSetHooks(CBJitter_t *jitter, CBJitterLateFn_t lateFn, CBJitterGapFn_t gapFn, void *arg);
+
+/*
+ * @brief This function inserts a received frame. It can be called by one
+ * 		receiver thread while another thread plays the frames.
+ *
+ * @param jitter, pointer to the jitter buffer to be used
+ * @param seq, sequence number of the frame. The first frame inserted starts the sequence
+ * @param timestamp, media timestamp of the frame
+ * @param frame, pointer to the frame to be copied
+ * @param now, arrival time of the frame
+ * @return CBStatus_t, return value. Returns CB_true if the frame was inserted,
+ * 		CB_false if it is late, a duplicate or too far in the future
+ */
+CBStatus_t emCircularJitterInsert(CBJitter_t *jitter, const uint64_t seq, const uint64_t timestamp,
+								  const void *frame, const uint64_t now);
+
+/*
+ * @brief This function returns the frame due at the current time, if any.
+ * 		Only the start of the reorder window is checked, so it is O(1).
+ * 		The frame is copied out of the reorder buffer, so the receiver can
+ * 		reuse its slot, and it is valid until the next call.
+ *
+ * @param jitter, pointer to the jitter buffer to be used
+ * @param now, current time
+ * @param seq, pointer where the sequence number of the frame is stored. Can be NULL
+ * @return void*, pointer to the frame, or to the concealment frame written by
+ * 		the gap hook. Returns NULL if no frame is due
+ */
+void *emCircularJitterGetFrame(CBJitter_t *jitter, const uint64_t now, uint64_t *seq);
+
+/*
+ * @brief This function returns the current playout depth.
+ *
+ * @param jitter, pointer to the jitter buffer to be checked
+ * @return uint64_t, playout depth
+ */
+uint64_t emCircularJitterGetDepth(const CBJitter_t *jitter);
+
+#endif /* EMCIRCULARJITTER_H_ */
@@ -0,0 +1,622 @@
+/*
+ * @file emCircularLog.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // nanosleep
+#endif
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "emCircularLog.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+#define CB_LOG_SPEC_PERCENT (-2) // "%%" conversion, it has no argument
+#define CB_LOG_SPEC_ERROR (-1)	 // conversion not supported
+#define CB_LOG_SPEC_SIZE 32		 // maximum length of a conversion specification
+
+/*
+ * Buffer of the calling thread in one logger
+ */
+typedef struct CBLogThreadRing_t
+{
+	uint64_t id;	 // id of the logger, 0 if the entry is free
+	CBuffer_t *ring; // buffer of the thread in the logger
+} CBLogThreadRing_t;
+
+/*
+ * Ids of the loggers, they are not reused so a stale entry of a deleted logger never matches
+ */
+static uint64_t emCircularLogNextId = 0;
+
+/*
+ * Buffers of the calling thread in the last loggers used. The address of
+ * emCircularLogKey identifies the thread in the owners of a logger.
+ */
+static _Thread_local CBLogThreadRing_t emCircularLogRings[CB_LOG_THREAD_LOGGERS];
+static _Thread_local size_t emCircularLogVictim = 0;
+static _Thread_local char emCircularLogKey;
+
+/*
+ * Remembers the buffer of the calling thread in the logger. The id is written
+ * last, so a signal handler that logs never sees the buffer of another logger.
+ */
+static void emCircularLogRemember(const CBLogger_t *logger, CBuffer_t *ring)
+{
+	CBLogThreadRing_t *entry = &emCircularLogRings[emCircularLogVictim];
+	emCircularLogVictim = (emCircularLogVictim + 1) % CB_LOG_THREAD_LOGGERS;
+	emCircularPort_AtomicStore(&entry->id, 0);
+	emCircularPort_AtomicStore(&entry->ring, ring);
+	emCircularPort_AtomicStore(&entry->id, logger->id);
+}
+
+/*
+ * Returns the buffer of the calling thread in the logger, NULL if the thread is not registered
+ */
+static CBuffer_t *emCircularLogFindRing(CBLogger_t *logger)
+{
+	for (size_t i = 0; i < CB_LOG_THREAD_LOGGERS; i++)
+	{
+		if (emCircularPort_AtomicLoad(&emCircularLogRings[i].id) == logger->id)
+			return emCircularPort_AtomicLoad(&emCircularLogRings[i].ring);
+	}
+	/* The thread can be registered and forgotten when it logs in more loggers */
+	size_t nbRings = emCircularPort_AtomicLoad(&logger->nbRings);
+	if (nbRings > CB_LOG_MAX_THREADS)
+	{
+		nbRings = CB_LOG_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		if (emCircularPort_AtomicLoad(&logger->owners[i]) == (const void *)&emCircularLogKey)
+		{
+			CBuffer_t *ring = emCircularPort_AtomicLoad(&logger->rings[i]);
+			emCircularLogRemember(logger, ring);
+			return ring;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Parses the conversion specification starting at p, that points to a '%'.
+ * Returns the pointer to the first character after the specification and
+ * stores the type of its argument in kind.
+ */
+static const char *emCircularLogParseSpec(const char *p, int *kind)
+{
+	const char *start = p;
+	*kind = CB_LOG_SPEC_ERROR;
+	p++;
+	if (*p == '%')
+	{
+		*kind = CB_LOG_SPEC_PERCENT;
+		return p + 1;
+	}
+	while ((*p == '-') || (*p == '+') || (*p == ' ') || (*p == '#') || (*p == '0'))
+		p++;
+	while ((*p >= '0') && (*p <= '9'))
+		p++;
+	if (*p == '.')
+	{
+		p++;
+		while ((*p >= '0') && (*p <= '9'))
+			p++;
+	}
+	int length = CB_LogArgInt;
+	switch (*p)
+	{
+	case 'h':
+		p += (p[1] == 'h') ? 2 : 1;
+		break;
+	case 'l':
+		length = (p[1] == 'l') ? CB_LogArgLongLong : CB_LogArgLong;
+		p += (p[1] == 'l') ? 2 : 1;
+		break;
+	case 'z':
+		length = CB_LogArgSize;
+		p++;
+		break;
+	case 'j':
+		length = CB_LogArgIntMax;
+		p++;
+		break;
+	case 't':
+		length = CB_LogArgPtrDiff;
+		p++;
+		break;
+	default:
+		break;
+	}
+	if ((p - start) >= (CB_LOG_SPEC_SIZE - 1))
+		return p;
+	switch (*p)
+	{
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c':
+		*kind = length;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if ((length == CB_LogArgInt) || (length == CB_LogArgLong))
+		{
+			*kind = CB_LogArgDouble;
+		}
+		break;
+	case 's':
+		if (length == CB_LogArgInt)
+		{
+			*kind = CB_LogArgStr;
+		}
+		break;
+	case 'p':
+		if (length == CB_LogArgInt)
+		{
+			*kind = CB_LogArgPtr;
+		}
+		break;
+	default:
+		break;
+	}
+	return (*p != '\0') ? p + 1 : p;
+}
+
+/*
+ * Returns the size of an argument in the record. Strings use at least
+ * their terminator.
+ */
+static size_t emCircularLogArgSize(const int kind)
+{
+	switch (kind)
+	{
+	case CB_LogArgInt:
+		return sizeof(int);
+	case CB_LogArgLong:
+		return sizeof(long);
+	case CB_LogArgLongLong:
+		return sizeof(long long);
+	case CB_LogArgSize:
+		return sizeof(size_t);
+	case CB_LogArgIntMax:
+		return sizeof(intmax_t);
+	case CB_LogArgPtrDiff:
+		return sizeof(ptrdiff_t);
+	case CB_LogArgDouble:
+		return sizeof(double);
+	case CB_LogArgPtr:
+		return sizeof(void *);
+	default:
+		return 1;
+	}
+}
+
+/*
+ * Formats a record in line, terminating it with a new line.
+ * Returns the length of the line.
+ */
+static size_t emCircularLogFormat(const CBLogger_t *logger, const CBLogRecord_t *record, char *line)
+{
+	const CBLogFormat_t *format = &logger->formats[record->formatId];
+	const char *p = format->fmt;
+	size_t len = 0;
+	size_t used = 0;
+	char spec[CB_LOG_SPEC_SIZE];
+	while ((*p != '\0') && (len < (CB_LOG_LINE_SIZE - 1)))
+	{
+		if (*p != '%')
+		{
+			line[len++] = *p++;
+			continue;
+		}
+		int kind;
+		const char *end = emCircularLogParseSpec(p, &kind);
+		if (kind == CB_LOG_SPEC_PERCENT)
+		{
+			line[len++] = '%';
+			p = end;
+			continue;
+		}
+		memcpy(spec, p, (size_t)(end - p));
+		spec[end - p] = '\0';
+		p = end;
+
+		size_t room = CB_LOG_LINE_SIZE - 1 - len;
+		int written = 0;
+		switch (kind)
+		{
+#define CB_LOG_FORMAT_ARG(type)                                         \
+	{                                                                   \
+		type value;                                                     \
+		memcpy(&value, record->args + used, sizeof(type));              \
+		used += sizeof(type);                                           \
+		written = snprintf(line + len, room, spec, value);              \
+		break;                                                          \
+	}
+		case CB_LogArgInt:
+			CB_LOG_FORMAT_ARG(int)
+		case CB_LogArgLong:
+			CB_LOG_FORMAT_ARG(long)
+		case CB_LogArgLongLong:
+			CB_LOG_FORMAT_ARG(long long)
+		case CB_LogArgSize:
+			CB_LOG_FORMAT_ARG(size_t)
+		case CB_LogArgIntMax:
+			CB_LOG_FORMAT_ARG(intmax_t)
+		case CB_LogArgPtrDiff:
+			CB_LOG_FORMAT_ARG(ptrdiff_t)
+		case CB_LogArgDouble:
+			CB_LOG_FORMAT_ARG(double)
+		case CB_LogArgPtr:
+			CB_LOG_FORMAT_ARG(void *)
+#undef CB_LOG_FORMAT_ARG
+		case CB_LogArgStr:
+		{
+			const char *str = (const char *)(record->args + used);
+			used += strlen(str) + 1;
+			written = snprintf(line + len, room, spec, str);
+			break;
+		}
+		default:
+			break;
+		}
+		if (written > 0)
+		{
+			len += ((size_t)written < room) ? (size_t)written : (room - 1);
+		}
+	}
+	line[len++] = '\n';
+	return len;
+}
+
+/*
+ * Writes all the lines of a batch, retrying on partial writes
+ */
+static void emCircularLogWriteBatch(const int fd, struct iovec *iov, size_t nbLines)
+{
+	while (nbLines > 0)
+	{
+		ssize_t written = writev(fd, iov, (int)nbLines);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			CB_DEBUG_Print("CB Error:\tCannot write the log lines!\r\n");
+			return;
+		}
+		while ((nbLines > 0) && ((size_t)written >= iov->iov_len))
+		{
+			written -= (ssize_t)iov->iov_len;
+			iov++;
+			nbLines--;
+		}
+		if (nbLines > 0)
+		{
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= (size_t)written;
+		}
+	}
+}
+
+/*
+ * Body of the background thread
+ */
+static void *emCircularLogThread(void *arg)
+{
+	CBLogger_t *logger = (CBLogger_t *)arg;
+	struct timespec idle = {0, CB_LOG_IDLE_US * 1000L};
+	while (emCircularPort_AtomicLoad(&logger->running))
+	{
+		if (emCircularLogProcess(logger) == 0)
+		{
+			nanosleep(&idle, NULL);
+		}
+	}
+	while (emCircularLogProcess(logger) != 0)
+	{
+	}
+	return NULL;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBLogger_t *emCircularLogInit(const int fd, const size_t ringElems)
+{
+	if (ringElems < 1)
+		return NULL;
+	CBLogger_t *retval = (CBLogger_t *)emCircularPortMalloc(sizeof(CBLogger_t));
+	if (retval == NULL)
+		return NULL;
+	memset(retval, 0, sizeof(CBLogger_t));
+	retval->lines = (char *)emCircularPortMalloc(CB_LOG_BATCH * CB_LOG_LINE_SIZE);
+	if (retval->lines == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	retval->id = emCircularPort_AtomicFetchAdd(&emCircularLogNextId, 1) + 1;
+	retval->fd = fd;
+	retval->ringElems = ringElems;
+	CB_DEBUG_Print("CB:\tLogger initialised. Logger pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularLogDelete(CBLogger_t *logger)
+{
+	if (logger == NULL)
+		return CB_error;
+	size_t nbRings = logger->nbRings;
+	if (nbRings > CB_LOG_MAX_THREADS)
+	{
+		nbRings = CB_LOG_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		if (logger->rings[i] != NULL)
+		{
+			emCircularDelete(logger->rings[i]);
+		}
+	}
+	for (size_t i = 0; i < CB_LOG_THREAD_LOGGERS; i++)
+	{
+		if (emCircularLogRings[i].id == logger->id)
+		{
+			emCircularLogRings[i].id = 0;
+			emCircularLogRings[i].ring = NULL;
+		}
+	}
+	emCircularPortFree(logger->lines);
+	emCircularPortFree(logger);
+	return CB_true;
+}
+
+int emCircularLogRegisterFormat(CBLogger_t *logger, const char *fmt)
+{
+	if ((logger == NULL) || (fmt == NULL))
+		return -1;
+	size_t index = logger->nbFormats;
+	if (index >= CB_LOG_MAX_FORMATS)
+		return -1;
+	CBLogFormat_t *format = &logger->formats[index];
+	format->fmt = fmt;
+	format->nbArgs = 0;
+	format->minSize = 0;
+	for (const char *p = fmt; *p != '\0';)
+	{
+		if (*p != '%')
+		{
+			p++;
+			continue;
+		}
+		int kind;
+		p = emCircularLogParseSpec(p, &kind);
+		if (kind == CB_LOG_SPEC_PERCENT)
+			continue;
+		if ((kind == CB_LOG_SPEC_ERROR) || (format->nbArgs >= CB_LOG_MAX_ARGS))
+		{
+			CB_DEBUG_Print("CB Error:\tLog format string not supported!\r\n");
+			return -1;
+		}
+		format->args[format->nbArgs++] = (unsigned char)kind;
+		format->minSize += emCircularLogArgSize(kind);
+	}
+	if (format->minSize > CB_LOG_MAX_ARGS_SIZE)
+	{
+		CB_DEBUG_Print("CB Error:\tLog format string has too many arguments!\r\n");
+		return -1;
+	}
+	emCircularPort_AtomicStore(&logger->nbFormats, index + 1);
+	return (int)index;
+}
+
+CBStatus_t emCircularLogRegisterThread(CBLogger_t *logger)
+{
+	if (logger == NULL)
+		return CB_error;
+	if (emCircularLogFindRing(logger) != NULL)
+		return CB_true;
+	size_t index = emCircularPort_AtomicFetchAdd(&logger->nbRings, 1);
+	if (index >= CB_LOG_MAX_THREADS)
+	{
+		CB_DEBUG_Print("CB Error:\tToo many threads registered in the logger!\r\n");
+		return CB_error;
+	}
+	CBuffer_t *ring = emCircularInit(logger->ringElems + 1, sizeof(CBLogRecord_t), NULL);
+	if (ring == NULL)
+		return CB_error;
+	emCircularPort_AtomicStore(&logger->rings[index], ring);
+	emCircularPort_AtomicStore(&logger->owners[index], (const void *)&emCircularLogKey);
+	emCircularLogRemember(logger, ring);
+	return CB_true;
+}
+
+CBStatus_t emCircularLog(CBLogger_t *logger, const int formatId, ...)
+{
+	if ((logger == NULL) || (formatId < 0))
+		return CB_error;
+	if ((size_t)formatId >= emCircularPort_AtomicLoad(&logger->nbFormats))
+		return CB_error;
+	CBuffer_t *ring = emCircularLogFindRing(logger);
+	if (ring == NULL)
+	{
+		if (emCircularLogRegisterThread(logger) != CB_true)
+			return CB_error;
+		ring = emCircularLogFindRing(logger);
+	}
+	const CBLogFormat_t *format = &logger->formats[formatId];
+	CBLogRecord_t record;
+	size_t used = 0;
+	size_t reserve = format->minSize;
+	va_list ap;
+	va_start(ap, formatId);
+	for (size_t i = 0; i < format->nbArgs; i++)
+	{
+		reserve -= emCircularLogArgSize(format->args[i]);
+		switch (format->args[i])
+		{
+#define CB_LOG_PACK_ARG(type, promoted)                       \
+	{                                                         \
+		type value = (type)va_arg(ap, promoted);              \
+		memcpy(record.args + used, &value, sizeof(type));     \
+		used += sizeof(type);                                 \
+		break;                                                \
+	}
+		case CB_LogArgInt:
+			CB_LOG_PACK_ARG(int, int)
+		case CB_LogArgLong:
+			CB_LOG_PACK_ARG(long, long)
+		case CB_LogArgLongLong:
+			CB_LOG_PACK_ARG(long long, long long)
+		case CB_LogArgSize:
+			CB_LOG_PACK_ARG(size_t, size_t)
+		case CB_LogArgIntMax:
+			CB_LOG_PACK_ARG(intmax_t, intmax_t)
+		case CB_LogArgPtrDiff:
+			CB_LOG_PACK_ARG(ptrdiff_t, ptrdiff_t)
+		case CB_LogArgDouble:
+			CB_LOG_PACK_ARG(double, double)
+		case CB_LogArgPtr:
+			CB_LOG_PACK_ARG(void *, void *)
+#undef CB_LOG_PACK_ARG
+		default:
+		{
+			const char *str = va_arg(ap, const char *);
+			size_t room = CB_LOG_MAX_ARGS_SIZE - used - reserve - 1;
+			size_t len = 0;
+			if (str == NULL)
+			{
+				str = "(null)";
+			}
+			while ((len < room) && (str[len] != '\0'))
+			{
+				record.args[used + len] = (unsigned char)str[len];
+				len++;
+			}
+			record.args[used + len] = '\0';
+			used += len + 1;
+			break;
+		}
+		}
+	}
+	va_end(ap);
+	record.formatId = (uint16_t)formatId;
+	record.argsSize = (uint16_t)used;
+
+	CBStatus_t retval = emCircularPushSignalSafe(ring, &record);
+	if (retval == CB_false)
+	{
+		emCircularPort_AtomicFetchAdd(&logger->dropped, 1);
+	}
+	return retval;
+}
+
+size_t emCircularLogProcess(CBLogger_t *logger)
+{
+	if (logger == NULL)
+		return 0;
+	struct iovec iov[CB_LOG_BATCH];
+	size_t nbLines = 0;
+	size_t retval = 0;
+	size_t nbRings = emCircularPort_AtomicLoad(&logger->nbRings);
+	if (nbRings > CB_LOG_MAX_THREADS)
+	{
+		nbRings = CB_LOG_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		CBuffer_t *ring = emCircularPort_AtomicLoad(&logger->rings[i]);
+		if (ring == NULL)
+			continue;
+		/* The record is released only after it is formatted */
+		CBLogRecord_t *record;
+		while ((record = (CBLogRecord_t *)emCircularPeekTail(ring, NULL)) != NULL)
+		{
+			char *line = logger->lines + (nbLines * CB_LOG_LINE_SIZE);
+			iov[nbLines].iov_base = line;
+			iov[nbLines].iov_len = emCircularLogFormat(logger, record, line);
+			emCircularGetTail(ring);
+			nbLines++;
+			retval++;
+			if (nbLines == CB_LOG_BATCH)
+			{
+				emCircularLogWriteBatch(logger->fd, iov, nbLines);
+				nbLines = 0;
+			}
+		}
+	}
+	if (nbLines > 0)
+	{
+		emCircularLogWriteBatch(logger->fd, iov, nbLines);
+	}
+	return retval;
+}
+
+CBStatus_t emCircularLogStart(CBLogger_t *logger)
+{
+	if (logger == NULL)
+		return CB_error;
+	emCircularPort_AtomicStore(&logger->running, 1);
+	if (pthread_create(&logger->thread, NULL, emCircularLogThread, logger) != 0)
+	{
+		emCircularPort_AtomicStore(&logger->running, 0);
+		CB_DEBUG_Print("CB Error:\tCannot start the logger thread!\r\n");
+		return CB_error;
+	}
+	return CB_true;
+}
+
+CBStatus_t emCircularLogStop(CBLogger_t *logger)
+{
+	if (logger == NULL)
+		return CB_error;
+	if (!emCircularPort_AtomicLoad(&logger->running))
+		return CB_false;
+	emCircularPort_AtomicStore(&logger->running, 0);
+	if (pthread_join(logger->thread, NULL) != 0)
+		return CB_error;
+	return CB_true;
+}
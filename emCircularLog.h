@@ -0,0 +1,190 @@
+/*
+ * @file emCircularLog.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements an asynchronous logger built on emCircularBuffer.
+ *
+ * Every thread that logs owns a circular buffer of fixed-size records. The producer
+ * only copies the id of a registered format string and the raw binary arguments in
+ * its own buffer; a background thread formats the records and writes them in
+ * batches to a file descriptor with writev(), so formatting and I/O are out of the
+ * critical path.
+ * The module needs a POSIX system (pthread, writev).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARLOG_H_
+#define EMCIRCULARLOG_H_
+
+#include <pthread.h>
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_LOG_MAX_ARGS_SIZE 64 // Maximum size in bytes of the arguments of a record
+#define CB_LOG_MAX_ARGS 16		// Maximum number of arguments of a format string
+#define CB_LOG_MAX_FORMATS 256	// Maximum number of format strings registered
+#define CB_LOG_MAX_THREADS 64	// Maximum number of threads that can log
+#define CB_LOG_THREAD_LOGGERS 4	// Loggers whose buffer is remembered by every thread
+#define CB_LOG_LINE_SIZE 256	// Maximum length of a formatted line
+#define CB_LOG_BATCH 64			// Number of lines written with a single writev()
+#define CB_LOG_IDLE_US 1000		// Sleep time of the background thread when there are no records
+
+/*
+ * Definition of the types of the arguments of a format string
+ */
+typedef enum
+{
+	CB_LogArgInt,
+	CB_LogArgLong,
+	CB_LogArgLongLong,
+	CB_LogArgSize,
+	CB_LogArgIntMax,
+	CB_LogArgPtrDiff,
+	CB_LogArgDouble,
+	CB_LogArgPtr,
+	CB_LogArgStr	// copied in the record, truncated if it does not fit
+} CBLogArg_t;
+
+/*
+ * Definition of a registered format string
+ */
+typedef struct CBLogFormat_t
+{
+	const char *fmt;					  // printf-like format string
+	size_t nbArgs;						  // number of arguments of the format string
+	size_t minSize;						  // minimum size of the arguments in a record
+	unsigned char args[CB_LOG_MAX_ARGS]; // type of every argument (CBLogArg_t)
+} CBLogFormat_t;
+
+/*
+ * Definition of the record stored in the buffers
+ */
+typedef struct CBLogRecord_t
+{
+	uint16_t formatId;						// id of the format string
+	uint16_t argsSize;						// number of bytes used in args
+	unsigned char args[CB_LOG_MAX_ARGS_SIZE]; // raw binary arguments
+} CBLogRecord_t;
+
+/*
+ * Definition of the logger data type
+ */
+typedef struct CBLogger_t
+{
+	uint64_t id;							// unique id of the logger, never reused
+	int fd;									// file descriptor where the lines are written
+	size_t ringElems;						// number of records of every thread buffer
+	CBLogFormat_t formats[CB_LOG_MAX_FORMATS]; // format strings registered
+	size_t nbFormats;						// number of format strings registered
+	CBuffer_t *rings[CB_LOG_MAX_THREADS];	// buffers of the threads registered
+	const void *owners[CB_LOG_MAX_THREADS];	// threads that own the buffers
+	size_t nbRings;							// number of buffers reserved
+	size_t dropped;							// number of records dropped because a buffer was full
+	char *lines;							// storage of the lines of a batch
+	int running;							// set while the background thread is running
+	pthread_t thread;						// background thread
+} CBLogger_t;
+
+/*
+ * @brief This function initializes the logger.
+ *
+ * @param fd, file descriptor where the log lines are written
+ * @param ringElems, number of records of the buffer of every thread
+ * @return CBLogger_t*, pointer to the logger created. Returns
+ * 		NULL if it was not possible to create the logger
+ */
+CBLogger_t *emCircularLogInit(const int fd, const size_t ringElems);
+
+/*
+ * @brief This function deletes the logger and frees all the buffers.
+ * 		The background thread must be stopped and no thread must be logging.
+ *
+ * @param logger, pointer to the logger to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularLogDelete(CBLogger_t *logger);
+
+/*
+ * @brief This function registers a printf-like format string. The types of
+ * 		the arguments are decoded here once, so the producers do not parse it.
+ * 		Conversions with '*' width or precision and long double are not supported.
+ * 		Every line written is terminated with a new line.
+ * 		It must not be called by more threads at the same time.
+ *
+ * @param logger, pointer to the logger to be used
+ * @param fmt, format string. It must stay valid while the logger is used
+ * @return int, id of the format string. Returns -1 if the format string
+ * 		is not supported or there is no space for it
+ */
+int emCircularLogRegisterFormat(CBLogger_t *logger, const char *fmt);
+
+/*
+ * @brief This function creates the buffer of the calling thread.
+ * 		It is called by emCircularLog() the first time a thread logs,
+ * 		it can be called before to keep the allocation out of the critical path.
+ * 		Every thread keeps one buffer per logger, also when it logs in more loggers.
+ * 		The buffer of a thread that exited can be reused by a later thread.
+ *
+ * @param logger, pointer to the logger to be used
+ * @return CBStatus_t, return value. Returns CB_true if the thread has
+ * 		its buffer, CB_error otherwise
+ */
+CBStatus_t emCircularLogRegisterThread(CBLogger_t *logger);
+
+/*
+ * @brief This function logs a record: the arguments are copied in binary
+ * 		form, as described by the format string, in the buffer of the calling thread.
+ *
+ * @param logger, pointer to the logger to be used
+ * @param formatId, id returned by emCircularLogRegisterFormat()
+ * @return CBStatus_t, return value. Returns CB_true if the record was stored,
+ * 		CB_false if the buffer of the thread was full and the record was dropped
+ */
+CBStatus_t emCircularLog(CBLogger_t *logger, const int formatId, ...);
+
+/*
+ * @brief This function formats the records of all the threads and writes them.
+ * 		It is the body of the background thread, and can be called directly
+ * 		when the background thread is not used.
+ *
+ * @param logger, pointer to the logger to be used
+ * @return size_t, number of records written
+ */
+size_t emCircularLogProcess(CBLogger_t *logger);
+
+/*
+ * @brief This function starts the background thread of the logger.
+ *
+ * @param logger, pointer to the logger to be used
+ * @return CBStatus_t, return value. Returns CB_true if the thread was started
+ */
+CBStatus_t emCircularLogStart(CBLogger_t *logger);
+
+/*
+ * @brief This function stops the background thread of the logger after
+ * 		writing all the records left.
+ *
+ * @param logger, pointer to the logger to be used
+ * @return CBStatus_t, return value. Returns CB_true if the thread was stopped
+ */
+CBStatus_t emCircularLogStop(CBLogger_t *logger);
+
+#endif /* EMCIRCULARLOG_H_ */
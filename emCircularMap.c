@@ -0,0 +1,160 @@
+/*
+ * @file emCircularMap.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "emCircularMap.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Publishes the results done and not yet published. The stage is the only producer
+ * of the output, so the slots reserved are the ones already written. If the output
+ * takes fewer slots than requested only those are published, and the others are
+ * published by a later call: committedSeq always matches the head of the output.
+ * One thread at a time publishes, the one that holds the flag checks again the
+ * results done by the others meanwhile.
+ */
+static void emCircularMapPublish(CBMapStage_t *stage)
+{
+	for (;;)
+	{
+		int expected = 0;
+		if (!emCircularPort_AtomicCAS(&stage->publishing, &expected, 1))
+			return;
+		uint64_t committed = emCircularPort_AtomicLoad(&stage->committedSeq);
+		size_t nbElems = (size_t)(emCircularPort_AtomicLoad(&stage->doneSeq) - committed);
+		size_t published = 0;
+		if (nbElems > 0)
+		{
+			CBSpan_t span;
+			published = emCircularGetHeadBatch(stage->output, nbElems, &span);
+			emCircularPort_AtomicStore(&stage->committedSeq, committed + published);
+		}
+		emCircularPort_AtomicStore(&stage->publishing, 0);
+		emCircularPort_AtomicFence();
+		if (published < nbElems)
+		{
+			CB_DEBUG_Print("CB:\tOutput buffer did not take all the results, they are published later.\r\n");
+			return;
+		}
+		if (emCircularPort_AtomicLoad(&stage->doneSeq) == (committed + published))
+			return;
+	}
+}
+
+/*
+ * Records the results of the input batches done, called in order by the batch consumer
+ */
+static void emCircularMapCommit(CBBatchConsumer_t *consumer, uint64_t seq, size_t nbElems, void *arg)
+{
+	(void)consumer;
+	CBMapStage_t *stage = (CBMapStage_t *)arg;
+	emCircularPort_AtomicStore(&stage->doneSeq, seq + nbElems);
+	emCircularMapPublish(stage);
+}
+
+/*
+ * Returns the input sequence number of the first result that does not fit in
+ * the output. committedSeq is read before the counters of the output, that are
+ * updated before it, so the free space is never overestimated.
+ */
+static uint64_t emCircularMapLimit(const CBMapStage_t *stage)
+{
+	uint64_t committed = emCircularPort_AtomicLoad(&stage->committedSeq);
+	size_t used = emCircularPort_AtomicLoad(&stage->output->NbReserved);
+	used += emCircularPort_AtomicLoad(&stage->output->NbHistory) + 1;
+	if (used >= stage->output->maxElems)
+		return committed;
+	return committed + (stage->output->maxElems - used);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBMapStage_t *emCircularMapInit(CBuffer_t *input, CBuffer_t *output, const size_t batchElems, CBMapFn_t fn,
+								void *arg)
+{
+	if ((input == NULL) || (output == NULL) || (input == output) || (fn == NULL))
+		return NULL;
+	CBMapStage_t *retval = (CBMapStage_t *)emCircularPortMalloc(sizeof(CBMapStage_t));
+	if (retval == NULL)
+		return NULL;
+	retval->consumer = emCircularBatchInit(input, batchElems);
+	if (retval->consumer == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	uint64_t startSeq = retval->consumer->claimSeq;
+	retval->output = output;
+	retval->outBase = (output->headInd + output->maxElems - (size_t)(startSeq % output->maxElems)) % output->maxElems;
+	retval->committedSeq = startSeq;
+	retval->doneSeq = startSeq;
+	retval->publishing = 0;
+	retval->fn = fn;
+	retval->arg = arg;
+	emCircularBatchSetRelease(retval->consumer, emCircularMapCommit, retval);
+	CB_DEBUG_Print("CB:\tMap stage initialised. Stage pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularMapDelete(CBMapStage_t *stage)
+{
+	if (stage == NULL)
+		return CB_error;
+	emCircularBatchDelete(stage->consumer);
+	emCircularPortFree(stage);
+	return CB_true;
+}
+
+size_t emCircularMapProcess(CBMapStage_t *stage)
+{
+	if (stage == NULL)
+		return 0;
+	/* The results not taken by the output before are retried first */
+	if (emCircularPort_AtomicLoad(&stage->doneSeq) != emCircularPort_AtomicLoad(&stage->committedSeq))
+	{
+		emCircularMapPublish(stage);
+	}
+	CBBatch_t batch;
+	size_t retval = emCircularBatchClaimLimit(stage->consumer, &batch, emCircularMapLimit(stage));
+	if (retval == 0)
+		return 0;
+	const unsigned char *in = (const unsigned char *)batch.elems;
+	CBuffer_t *output = stage->output;
+	for (size_t i = 0; i < retval; i++)
+	{
+		size_t index = (stage->outBase + (size_t)((batch.seq + i) % output->maxElems)) % output->maxElems;
+		stage->fn(in + (i * stage->consumer->ring->elemSize), output->startBuffer + (index * output->elemSize),
+				  stage->arg);
+	}
+	emCircularBatchDone(stage->consumer, &batch);
+	return retval;
+}
@@ -0,0 +1,96 @@
+/*
+ * @file emCircularMap.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements an order-preserving parallel map stage between
+ * two circular buffers.
+ *
+ * Many workers claim batches of the input buffer (see emCircularBatch.h) and
+ * write the result of every element directly in the output slot of its sequence
+ * number, out of order. When the batches are done in order the output slots are
+ * published with a single emCircularGetHeadBatch(), so the results reach the
+ * output consumer in the input order without any extra copy. The elements in
+ * progress are bounded by the free space of the output buffer.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARMAP_H_
+#define EMCIRCULARMAP_H_
+
+#include "emCircularBatch.h"
+
+/*
+ * Definition of the function that writes the result of an input element
+ * in its output slot
+ */
+typedef void (*CBMapFn_t)(const void *in, void *out, void *arg);
+
+/*
+ * Definition of the map stage data type
+ */
+typedef struct CBMapStage_t
+{
+	CBBatchConsumer_t *consumer; // batch consumer of the input buffer
+	CBuffer_t *output;			 // output buffer, written only by the stage
+	size_t outBase;				 // output index of the input sequence number 0, modulo maxElems
+	uint64_t committedSeq;		 // input sequence number of the next result to be published
+	uint64_t doneSeq;			 // input sequence number after the last result done in order
+	int publishing;				 // set while a thread publishes the results
+	CBMapFn_t fn;				 // function applied on every element
+	void *arg;					 // user argument of the map function
+} CBMapStage_t;
+
+/*
+ * @brief This function initializes the map stage. From this point the tail of
+ * 		the input buffer and the head of the output buffer must be moved only by
+ * 		the stage. The output buffer must not use the overwrite mode nor the
+ * 		rate limiter.
+ *
+ * @param input, pointer to the circular buffer of the elements to be mapped
+ * @param output, pointer to the circular buffer of the results
+ * @param batchElems, maximum number of elements claimed at once by a worker
+ * @param fn, function applied on every element
+ * @param arg, user argument passed to fn
+ * @return CBMapStage_t*, pointer to the map stage created. Returns
+ * 		NULL if it was not possible to create the map stage
+ */
+CBMapStage_t *emCircularMapInit(CBuffer_t *input, CBuffer_t *output, const size_t batchElems, CBMapFn_t fn,
+								void *arg);
+
+/*
+ * @brief This function deletes the map stage. The buffers are not deleted.
+ *
+ * @param stage, pointer to the map stage to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularMapDelete(CBMapStage_t *stage);
+
+/*
+ * @brief This function claims a batch of input elements, writes their results
+ * 		in the output buffer and publishes all the results completed in order.
+ * 		The results that the output buffer did not take are published again
+ * 		by the next calls. It is called in loop by every worker.
+ *
+ * @param stage, pointer to the map stage to be used
+ * @return size_t, number of elements mapped. Returns 0 if there are no input
+ * 		elements or no free space in the output buffer
+ */
+size_t emCircularMapProcess(CBMapStage_t *stage);
+
+#endif /* EMCIRCULARMAP_H_ */
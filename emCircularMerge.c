@@ -0,0 +1,293 @@
+/*
+ * @file emCircularMerge.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularMerge.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+#define CB_MERGE_IN_HEAP 0 // the tail element of the input is in the heap
+#define CB_MERGE_PENDING 1 // the input is empty and not closed
+#define CB_MERGE_DONE 2	   // the input is empty and closed
+
+/*
+ * Compares two inputs by the key of their tail element, the index breaks the ties
+ */
+static int emCircularMergeLess(const CBMerger_t *merger, const size_t a, const size_t b)
+{
+	if (merger->keys[a] != merger->keys[b])
+		return merger->keys[a] < merger->keys[b];
+	return a < b;
+}
+
+static void emCircularMergeSiftUp(CBMerger_t *merger, size_t pos)
+{
+	size_t input = merger->heap[pos];
+	while (pos > 0)
+	{
+		size_t parent = (pos - 1) / 2;
+		if (!emCircularMergeLess(merger, input, merger->heap[parent]))
+			break;
+		merger->heap[pos] = merger->heap[parent];
+		pos = parent;
+	}
+	merger->heap[pos] = input;
+}
+
+static void emCircularMergeSiftDown(CBMerger_t *merger, size_t pos)
+{
+	size_t input = merger->heap[pos];
+	for (;;)
+	{
+		size_t child = (2 * pos) + 1;
+		if (child >= merger->heapSize)
+			break;
+		if (((child + 1) < merger->heapSize) && emCircularMergeLess(merger, merger->heap[child + 1], merger->heap[child]))
+		{
+			child++;
+		}
+		if (!emCircularMergeLess(merger, merger->heap[child], input))
+			break;
+		merger->heap[pos] = merger->heap[child];
+		pos = child;
+	}
+	merger->heap[pos] = input;
+}
+
+/*
+ * Reads the new tail element of an input. The input is moved in the heap, or
+ * left out of it as pending or done if it is empty. Returns CB_true if the input
+ * has a tail element.
+ */
+static CBStatus_t emCircularMergeLoad(CBMerger_t *merger, const size_t input)
+{
+	int closed = emCircularPort_AtomicLoad(&merger->closed[input]);
+	void *head = emCircularPeekTail(merger->inputs[input], NULL);
+	if (head == NULL)
+	{
+		merger->state[input] = closed ? CB_MERGE_DONE : CB_MERGE_PENDING;
+		return CB_false;
+	}
+	merger->heads[input] = head;
+	merger->keys[input] = merger->key(head, merger->keyArg);
+	merger->state[input] = CB_MERGE_IN_HEAP;
+	return CB_true;
+}
+
+/*
+ * Moves in the heap the pending inputs that received an element. Returns
+ * CB_true if no input is pending anymore, so the root of the heap can be taken.
+ */
+static CBStatus_t emCircularMergeRefill(CBMerger_t *merger)
+{
+	if (merger->nbPending == 0)
+		return CB_true;
+	for (size_t i = 0; i < merger->nbInputs; i++)
+	{
+		if (merger->state[i] != CB_MERGE_PENDING)
+			continue;
+		if (emCircularMergeLoad(merger, i) == CB_true)
+		{
+			merger->heap[merger->heapSize++] = i;
+			emCircularMergeSiftUp(merger, merger->heapSize - 1);
+		}
+		if (merger->state[i] != CB_MERGE_PENDING)
+		{
+			merger->nbPending--;
+		}
+	}
+	return (merger->nbPending == 0) ? CB_true : CB_false;
+}
+
+/*
+ * Releases the tail element of the root input and puts its next element in the heap
+ */
+static void emCircularMergeAdvance(CBMerger_t *merger)
+{
+	size_t input = merger->heap[0];
+	emCircularGetTail(merger->inputs[input]);
+	if (emCircularMergeLoad(merger, input) != CB_true)
+	{
+		if (merger->state[input] == CB_MERGE_PENDING)
+		{
+			merger->nbPending++;
+		}
+		merger->heapSize--;
+		if (merger->heapSize == 0)
+			return;
+		merger->heap[0] = merger->heap[merger->heapSize];
+	}
+	emCircularMergeSiftDown(merger, 0);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBMerger_t *emCircularMergeInit(CBuffer_t *const *inputs, const size_t nbInputs, CBKeyExtractor_t key,
+								void *keyArg)
+{
+	if ((inputs == NULL) || (nbInputs < 1) || (key == NULL))
+		return NULL;
+	CBMerger_t *retval = (CBMerger_t *)emCircularPortMalloc(sizeof(CBMerger_t));
+	if (retval == NULL)
+		return NULL;
+	retval->inputs = (CBuffer_t **)emCircularPortMalloc(nbInputs * sizeof(CBuffer_t *));
+	retval->heap = (size_t *)emCircularPortMalloc(nbInputs * sizeof(size_t));
+	retval->keys = (uint64_t *)emCircularPortMalloc(nbInputs * sizeof(uint64_t));
+	retval->heads = (void **)emCircularPortMalloc(nbInputs * sizeof(void *));
+	retval->state = (unsigned char *)emCircularPortMalloc(nbInputs);
+	retval->closed = (int *)emCircularPortMalloc(nbInputs * sizeof(int));
+	if ((retval->inputs == NULL) || (retval->heap == NULL) || (retval->keys == NULL) || (retval->heads == NULL) ||
+		(retval->state == NULL) || (retval->closed == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the merger!\r\n");
+		emCircularMergeDelete(retval);
+		return NULL;
+	}
+	memcpy(retval->inputs, inputs, nbInputs * sizeof(CBuffer_t *));
+	memset(retval->closed, 0, nbInputs * sizeof(int));
+	memset(retval->state, CB_MERGE_PENDING, nbInputs);
+	retval->nbInputs = nbInputs;
+	retval->key = key;
+	retval->keyArg = keyArg;
+	retval->heapSize = 0;
+	retval->nbPending = nbInputs;
+	CB_DEBUG_Print("CB:\tMerger initialised. Merger pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularMergeDelete(CBMerger_t *merger)
+{
+	if (merger == NULL)
+		return CB_error;
+	if (merger->inputs != NULL)
+		emCircularPortFree(merger->inputs);
+	if (merger->heap != NULL)
+		emCircularPortFree(merger->heap);
+	if (merger->keys != NULL)
+		emCircularPortFree(merger->keys);
+	if (merger->heads != NULL)
+		emCircularPortFree(merger->heads);
+	if (merger->state != NULL)
+		emCircularPortFree(merger->state);
+	if (merger->closed != NULL)
+		emCircularPortFree(merger->closed);
+	emCircularPortFree(merger);
+	return CB_true;
+}
+
+CBStatus_t emCircularMergeCloseInput(CBMerger_t *merger, const size_t input)
+{
+	if ((merger == NULL) || (input >= merger->nbInputs))
+		return CB_error;
+	emCircularPort_AtomicStore(&merger->closed[input], 1);
+	return CB_true;
+}
+
+void *emCircularMergePeek(CBMerger_t *merger, size_t *input)
+{
+	if (merger == NULL)
+		return NULL;
+	if ((emCircularMergeRefill(merger) != CB_true) || (merger->heapSize == 0))
+		return NULL;
+	if (input != NULL)
+	{
+		*input = merger->heap[0];
+	}
+	return merger->heads[merger->heap[0]];
+}
+
+CBStatus_t emCircularMergeNext(CBMerger_t *merger)
+{
+	if (merger == NULL)
+		return CB_error;
+	if ((emCircularMergeRefill(merger) != CB_true) || (merger->heapSize == 0))
+		return CB_false;
+	emCircularMergeAdvance(merger);
+	return CB_true;
+}
+
+size_t emCircularMergePopBatch(CBMerger_t *merger, CBMergeFn_t fn, void *arg, const size_t maxElems)
+{
+	if ((merger == NULL) || (fn == NULL))
+		return 0;
+	size_t retval = 0;
+	while ((retval < maxElems) && (emCircularMergeRefill(merger) == CB_true) && (merger->heapSize > 0))
+	{
+		size_t input = merger->heap[0];
+		/* The run of the root input goes on while it is lower than both its children */
+		size_t limit = merger->nbInputs;
+		if (merger->heapSize > 1)
+		{
+			limit = merger->heap[1];
+			if ((merger->heapSize > 2) && emCircularMergeLess(merger, merger->heap[2], limit))
+			{
+				limit = merger->heap[2];
+			}
+		}
+		for (;;)
+		{
+			fn(merger->heads[input], input, arg);
+			retval++;
+			emCircularGetTail(merger->inputs[input]);
+			if (emCircularMergeLoad(merger, input) != CB_true)
+			{
+				if (merger->state[input] == CB_MERGE_PENDING)
+				{
+					merger->nbPending++;
+				}
+				merger->heapSize--;
+				if (merger->heapSize > 0)
+				{
+					merger->heap[0] = merger->heap[merger->heapSize];
+					emCircularMergeSiftDown(merger, 0);
+				}
+				break;
+			}
+			if ((limit != merger->nbInputs) && !emCircularMergeLess(merger, input, limit))
+			{
+				emCircularMergeSiftDown(merger, 0);
+				break;
+			}
+			if (retval == maxElems)
+				break;
+		}
+	}
+	return retval;
+}
+
+CBStatus_t emCircularMergeIsDone(CBMerger_t *merger)
+{
+	if (merger == NULL)
+		return CB_error;
+	emCircularMergeRefill(merger);
+	return ((merger->nbPending == 0) && (merger->heapSize == 0)) ? CB_true : CB_false;
+}
@@ -0,0 +1,138 @@
+/*
+ * @file emCircularMerge.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a k-way merge of circular buffers ordered by a key.
+ *
+ * The merger keeps a binary heap with the tail element of every input buffer,
+ * ordered by a key read with a user function (e.g. a timestamp), and gives the
+ * elements in global key order without copying them: they are used in place and
+ * released from their input buffer afterwards. No memory is allocated after the init.
+ * Every input must be ordered by key. An input that is empty stops the merge
+ * until it receives an element or it is closed, since its next element could
+ * have the lowest key.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARMERGE_H_
+#define EMCIRCULARMERGE_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the function that receives the elements merged by
+ * emCircularMergePopBatch(). elem points in the input buffer and is
+ * released after the function returns.
+ */
+typedef void (*CBMergeFn_t)(const void *elem, size_t input, void *arg);
+
+/*
+ * Definition of the merger data type
+ */
+typedef struct CBMerger_t
+{
+	CBuffer_t **inputs;			// input buffers
+	size_t nbInputs;			// number of input buffers
+	CBKeyExtractor_t key;		// function that reads the key of an element
+	void *keyArg;				// user argument of the key function
+	size_t *heap;				// inputs with a tail element, ordered by key
+	size_t heapSize;			// number of inputs in the heap
+	uint64_t *keys;				// key of the tail element of every input
+	void **heads;				// tail element of every input
+	unsigned char *state;		// state of every input (in heap, pending, done)
+	int *closed;				// set when no more elements will be pushed in the input
+	size_t nbPending;			// number of inputs not in the heap and not done
+} CBMerger_t;
+
+/*
+ * @brief This function initializes the merger.
+ *
+ * @param inputs, array of the input buffers, copied in the merger
+ * @param nbInputs, number of input buffers
+ * @param key, function that reads the key of an element
+ * @param keyArg, user argument passed to the key function
+ * @return CBMerger_t*, pointer to the merger created. Returns
+ * 		NULL if it was not possible to create the merger
+ */
+CBMerger_t *emCircularMergeInit(CBuffer_t *const *inputs, const size_t nbInputs, CBKeyExtractor_t key,
+								void *keyArg);
+
+/*
+ * @brief This function deletes the merger. The input buffers are not deleted.
+ *
+ * @param merger, pointer to the merger to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularMergeDelete(CBMerger_t *merger);
+
+/*
+ * @brief This function marks an input as closed: no more elements will be
+ * 		pushed in it, so the merge goes on without it once it is empty.
+ * 		It can be called by the producer of the input.
+ *
+ * @param merger, pointer to the merger to be used
+ * @param input, index of the input to be closed
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularMergeCloseInput(CBMerger_t *merger, const size_t input);
+
+/*
+ * @brief This function returns the element with the lowest key, without
+ * 		removing it from its input buffer.
+ *
+ * @param merger, pointer to the merger to be used
+ * @param input, filled with the index of the input of the element. Can be NULL
+ * @return void*, pointer to the element in its input buffer. Returns NULL
+ * 		if an input that is not closed is empty or all the inputs are done
+ */
+void *emCircularMergePeek(CBMerger_t *merger, size_t *input);
+
+/*
+ * @brief This function removes the element returned by emCircularMergePeek()
+ * 		from its input buffer.
+ *
+ * @param merger, pointer to the merger to be used
+ * @return CBStatus_t, return value. Returns CB_true if the element was
+ * 		removed, CB_false if there was no element to be removed
+ */
+CBStatus_t emCircularMergeNext(CBMerger_t *merger);
+
+/*
+ * @brief This function gives up to maxElems elements in key order to fn and
+ * 		removes them from their input buffers. Consecutive elements of the same
+ * 		input that are lower than the tail of all the other inputs are given
+ * 		without touching the heap.
+ *
+ * @param merger, pointer to the merger to be used
+ * @param fn, function called on every element
+ * @param arg, user argument passed to fn
+ * @param maxElems, maximum number of elements to be merged
+ * @return size_t, number of elements merged
+ */
+size_t emCircularMergePopBatch(CBMerger_t *merger, CBMergeFn_t fn, void *arg, const size_t maxElems);
+
+/*
+ * @brief This function is used to know if all the inputs are closed and empty.
+ *
+ * @param merger, pointer to the merger to be checked
+ * @return CBStatus_t, return value. Returns CB_true if the merge is completed
+ */
+CBStatus_t emCircularMergeIsDone(CBMerger_t *merger);
+
+#endif /* EMCIRCULARMERGE_H_ */
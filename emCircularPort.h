@@ -41,6 +41,12 @@
  */
 #define CIRCULAR_USE_LOCK_MECHANISM 0
 
+/*
+ * Use this define to enable/disable the token bucket rate limiter
+ * of emCircularGetHead() (see emCircularSetRateLimit())
+ */
+#define CIRCULAR_USE_RATE_LIMIT 0
+
 /*
  * Definition of necessary functions for memory management:
  * 		emCircularPortMalloc(bytes) [dynamic memory allocation]
@@ -95,4 +101,73 @@ typedef osSemaphoreId_t CB_sem_t;
 typedef void *CB_sem_t;
 #endif /* USE_LOCK_MECHANISM */
 
+/*
+ * Necessary definition for the monotonic time base used by the rate limiter.
+ * It is read only when a push is done on a rate limited buffer.
+ * 		emCircularPort_GetTick() [monotonic tick counter]
+ * 			@return uint32_t, current tick count. It is allowed to wrap
+ * 		emCircularPort_GetTickFreq() [frequency of the tick counter]
+ * 			@return uint32_t, number of ticks per second
+ *
+ * Note: here is used the library "cmsis_os2.h" to handle the system-calls, as example
+ */
+#if CIRCULAR_USE_RATE_LIMIT
+#include "cmsis_os2.h"
+#define emCircularPort_GetTick() ((uint32_t)osKernelGetTickCount())
+#define emCircularPort_GetTickFreq() ((uint32_t)osKernelGetTickFreq())
+#endif /* CIRCULAR_USE_RATE_LIMIT */
+
+/*
+ * Necessary definition for the atomic operations used by the lock-free parts
+ * of the module. They work on plain integer and pointer variables.
+ * 		emCircularPort_AtomicLoad(ptr) [load with acquire semantic]
+ * 			@param ptr, pointer to the variable
+ * 			@return value of the variable
+ * 		emCircularPort_AtomicStore(ptr, val) [store with release semantic]
+ * 			@param ptr, pointer to the variable
+ * 			@param val, value to be stored
+ * 		emCircularPort_AtomicFetchAdd(ptr, val) [sequentially consistent addition]
+ * 			@return value of the variable before the addition
+ * 		emCircularPort_AtomicFetchSub(ptr, val) [sequentially consistent subtraction]
+ * 			@return value of the variable before the subtraction
+ * 		emCircularPort_AtomicFetchOr(ptr, val) [sequentially consistent bitwise or]
+ * 			@return value of the variable before the operation
+ * 		emCircularPort_AtomicFetchAnd(ptr, val) [sequentially consistent bitwise and]
+ * 			@return value of the variable before the operation
+ * 		emCircularPort_AtomicCAS(ptr, expPtr, val) [sequentially consistent compare and swap]
+ * 			@param expPtr, pointer to the expected value, updated with the actual
+ * 				value of the variable if the swap fails
+ * 			@return non zero if val was stored
+ * 		emCircularPort_AtomicFence() [sequentially consistent memory barrier]
+ * 		emCircularPort_CpuRelax() [hint to the cpu inside a spin loop]
+ *
+ * Note: here are used the __atomic builtins of GCC and Clang, as example
+ */
+#define emCircularPort_AtomicLoad(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define emCircularPort_AtomicStore(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define emCircularPort_AtomicFetchAdd(ptr, val) __atomic_fetch_add((ptr), (val), __ATOMIC_SEQ_CST)
+#define emCircularPort_AtomicFetchSub(ptr, val) __atomic_fetch_sub((ptr), (val), __ATOMIC_SEQ_CST)
+#define emCircularPort_AtomicFetchOr(ptr, val) __atomic_fetch_or((ptr), (val), __ATOMIC_SEQ_CST)
+#define emCircularPort_AtomicFetchAnd(ptr, val) __atomic_fetch_and((ptr), (val), __ATOMIC_SEQ_CST)
+#define emCircularPort_AtomicCAS(ptr, expPtr, val) \
+	__atomic_compare_exchange_n((ptr), (expPtr), (val), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define emCircularPort_AtomicFence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#if defined(__x86_64__) || defined(__i386__)
+#define emCircularPort_CpuRelax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define emCircularPort_CpuRelax() __asm__ __volatile__("yield")
+#else
+#define emCircularPort_CpuRelax() ((void)0)
+#endif
+
+/*
+ * Necessary definition for the bit operations used by the presence bitmaps.
+ * 		emCircularPort_Ctz64(val) [count of the trailing zero bits]
+ * 			@param val, 64-bit value, must not be 0
+ * 			@return index of the lowest bit set in val
+ *
+ * Note: here is used the builtin of GCC and Clang, as example
+ */
+#define emCircularPort_Ctz64(val) ((size_t)__builtin_ctzll((unsigned long long)(val)))
+
 #endif /* EMCIRCULARPORT_H_ */
@@ -0,0 +1,317 @@
+/*
+ * @file emCircularRecorder.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "emCircularRecorder.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Buffer of the calling thread in one recorder
+ */
+typedef struct CBRecThreadRing_t
+{
+	uint64_t id;  // id of the recorder, 0 if the entry is free
+	size_t index; // index of the buffer of the thread in the recorder
+} CBRecThreadRing_t;
+
+/*
+ * Ids of the recorders, they are not reused so a stale entry of a deleted recorder never matches
+ */
+static uint64_t emCircularRecNextId = 0;
+
+/*
+ * Buffers of the calling thread in the last recorders used. The address of
+ * emCircularRecKey identifies the thread in the owners of a recorder.
+ */
+static _Thread_local CBRecThreadRing_t emCircularRecRings[CB_REC_THREAD_RECORDERS];
+static _Thread_local size_t emCircularRecVictim = 0;
+static _Thread_local char emCircularRecKey;
+
+/*
+ * Remembers the buffer of the calling thread in the recorder. The id is written
+ * last, so a signal handler that records never sees the buffer of another recorder.
+ */
+static void emCircularRecRemember(const CBRecorder_t *recorder, const size_t index)
+{
+	CBRecThreadRing_t *entry = &emCircularRecRings[emCircularRecVictim];
+	emCircularRecVictim = (emCircularRecVictim + 1) % CB_REC_THREAD_RECORDERS;
+	emCircularPort_AtomicStore(&entry->id, 0);
+	emCircularPort_AtomicStore(&entry->index, index);
+	emCircularPort_AtomicStore(&entry->id, recorder->id);
+}
+
+/*
+ * Returns the index of the buffer of the calling thread in the recorder,
+ * CB_REC_MAX_THREADS if the thread is not registered
+ */
+static size_t emCircularRecFindIndex(CBRecorder_t *recorder)
+{
+	for (size_t i = 0; i < CB_REC_THREAD_RECORDERS; i++)
+	{
+		if (emCircularPort_AtomicLoad(&emCircularRecRings[i].id) == recorder->id)
+			return emCircularPort_AtomicLoad(&emCircularRecRings[i].index);
+	}
+	/* The thread can be registered and forgotten when it records in more recorders */
+	size_t nbRings = emCircularPort_AtomicLoad(&recorder->nbRings);
+	if (nbRings > CB_REC_MAX_THREADS)
+	{
+		nbRings = CB_REC_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		if ((emCircularPort_AtomicLoad(&recorder->owners[i]) == (const void *)&emCircularRecKey) &&
+			(emCircularPort_AtomicLoad(&recorder->rings[i]) != NULL))
+		{
+			emCircularRecRemember(recorder, i);
+			return i;
+		}
+	}
+	return CB_REC_MAX_THREADS;
+}
+
+/*
+ * Writes all the bytes of data, retrying on partial writes
+ */
+static CBStatus_t emCircularRecorderWrite(const int fd, const void *data, size_t size)
+{
+	const unsigned char *ptr = (const unsigned char *)data;
+	while (size > 0)
+	{
+		ssize_t written = write(fd, ptr, size);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return CB_error;
+		}
+		ptr += written;
+		size -= (size_t)written;
+	}
+	return CB_true;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBRecorder_t *emCircularRecorderInit(const size_t ringElems)
+{
+	if (ringElems < 1)
+		return NULL;
+	CBRecorder_t *retval = (CBRecorder_t *)emCircularPortMalloc(sizeof(CBRecorder_t));
+	if (retval == NULL)
+		return NULL;
+	memset(retval, 0, sizeof(CBRecorder_t));
+	retval->id = emCircularPort_AtomicFetchAdd(&emCircularRecNextId, 1) + 1;
+	retval->ringElems = ringElems;
+	CB_DEBUG_Print("CB:\tRecorder initialised. Recorder pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularRecorderDelete(CBRecorder_t *recorder)
+{
+	if (recorder == NULL)
+		return CB_error;
+	size_t nbRings = recorder->nbRings;
+	if (nbRings > CB_REC_MAX_THREADS)
+	{
+		nbRings = CB_REC_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		if (recorder->rings[i] != NULL)
+		{
+			emCircularDelete(recorder->rings[i]);
+		}
+	}
+	for (size_t i = 0; i < CB_REC_THREAD_RECORDERS; i++)
+	{
+		if (emCircularRecRings[i].id == recorder->id)
+		{
+			emCircularRecRings[i].id = 0;
+		}
+	}
+	emCircularPortFree(recorder);
+	return CB_true;
+}
+
+CBStatus_t emCircularRecorderRegisterThread(CBRecorder_t *recorder)
+{
+	if (recorder == NULL)
+		return CB_error;
+	if (emCircularRecFindIndex(recorder) < CB_REC_MAX_THREADS)
+		return CB_true;
+	size_t index = emCircularPort_AtomicFetchAdd(&recorder->nbRings, 1);
+	if (index >= CB_REC_MAX_THREADS)
+	{
+		CB_DEBUG_Print("CB Error:\tToo many threads registered in the recorder!\r\n");
+		return CB_error;
+	}
+	CBuffer_t *ring = emCircularInit(recorder->ringElems + 1, sizeof(CBRecEvent_t), NULL);
+	if (ring == NULL)
+		return CB_error;
+	emCircularSetOverwrite(ring, CB_true);
+	emCircularPort_AtomicStore(&recorder->owners[index], (const void *)&emCircularRecKey);
+	emCircularPort_AtomicStore(&recorder->rings[index], ring);
+	emCircularRecRemember(recorder, index);
+	return CB_true;
+}
+
+CBStatus_t emCircularRecord(CBRecorder_t *recorder, const uint32_t eventId, const void *payload, size_t size)
+{
+	if (recorder == NULL)
+		return CB_error;
+	size_t index = emCircularRecFindIndex(recorder);
+	if (index >= CB_REC_MAX_THREADS)
+	{
+		if (emCircularRecorderRegisterThread(recorder) != CB_true)
+			return CB_error;
+		index = emCircularRecFindIndex(recorder);
+	}
+	CBuffer_t *ring = recorder->rings[index];
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	/* The event is published only when it is complete, so the dump never reads it half written */
+	CBSpan_t span;
+	if (emCircularReserveHeadBatch(ring, 1, &span) != 1)
+		return CB_error;
+	CBRecEvent_t *event = (CBRecEvent_t *)span.first;
+	event->timestamp = ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+	event->threadId = (uint32_t)index;
+	event->eventId = eventId;
+	if (size > CB_REC_PAYLOAD_SIZE)
+	{
+		size = CB_REC_PAYLOAD_SIZE;
+	}
+	if ((payload != NULL) && (size > 0))
+	{
+		memcpy(event->payload, payload, size);
+	}
+	memset(event->payload + size, 0, CB_REC_PAYLOAD_SIZE - size);
+	return emCircularCommitHeadBatch(ring, &span);
+}
+
+CBStatus_t emCircularRecorderDump(const CBRecorder_t *recorder, const int fd)
+{
+	if (recorder == NULL)
+		return CB_error;
+	uint64_t cursors[CB_REC_MAX_THREADS];
+	uint64_t ends[CB_REC_MAX_THREADS];
+	CBuffer_t *rings[CB_REC_MAX_THREADS];
+	CBRecEvent_t heads[CB_REC_MAX_THREADS];
+	unsigned char hasHead[CB_REC_MAX_THREADS];
+	CBRecEvent_t batch[CB_REC_DUMP_BATCH];
+	size_t nbEvents = 0;
+
+	size_t nbRings = emCircularPort_AtomicLoad(&recorder->nbRings);
+	if (nbRings > CB_REC_MAX_THREADS)
+	{
+		nbRings = CB_REC_MAX_THREADS;
+	}
+	for (size_t i = 0; i < nbRings; i++)
+	{
+		rings[i] = emCircularPort_AtomicLoad(&recorder->rings[i]);
+		cursors[i] = 0;
+		ends[i] = 0;
+		hasHead[i] = 0;
+		if (rings[i] != NULL)
+		{
+			ends[i] = emCircularGetHeadSeq(rings[i]);
+			cursors[i] = emCircularGetTailSeq(rings[i]);
+		}
+	}
+
+	CBRecFileHeader_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "EMCREC1", sizeof("EMCREC1"));
+	header.eventSize = sizeof(CBRecEvent_t);
+	header.nbThreads = (uint32_t)nbRings;
+	if (emCircularRecorderWrite(fd, &header, sizeof(header)) != CB_true)
+		return CB_error;
+
+	for (;;)
+	{
+		/* The number of threads is small, a linear search of the oldest head is enough */
+		const CBRecEvent_t *oldest = NULL;
+		size_t oldestRing = 0;
+		for (size_t i = 0; i < nbRings; i++)
+		{
+			while ((hasHead[i] == 0) && (cursors[i] < ends[i]))
+			{
+				/* The owner thread can overwrite the event while it is copied: the copy
+				 * is kept only if the event is still in the buffer after it */
+				const CBRecEvent_t *event = (const CBRecEvent_t *)emCircularPeekSeq(rings[i], cursors[i]);
+				if (event != NULL)
+				{
+					heads[i] = *event;
+					emCircularPort_AtomicFence();
+				}
+				uint64_t tailSeq = emCircularGetTailSeq(rings[i]);
+				if ((event != NULL) && (tailSeq <= cursors[i]))
+				{
+					hasHead[i] = 1;
+				}
+				else
+				{
+					/* Overwritten while dumping: restart from the oldest event left */
+					cursors[i] = (tailSeq > cursors[i]) ? tailSeq : ends[i];
+				}
+			}
+			if ((hasHead[i] != 0) && ((oldest == NULL) || (heads[i].timestamp < oldest->timestamp)))
+			{
+				oldest = &heads[i];
+				oldestRing = i;
+			}
+		}
+		if (oldest == NULL)
+			break;
+		batch[nbEvents++] = *oldest;
+		hasHead[oldestRing] = 0;
+		cursors[oldestRing]++;
+		if (nbEvents == CB_REC_DUMP_BATCH)
+		{
+			if (emCircularRecorderWrite(fd, batch, sizeof(batch)) != CB_true)
+				return CB_error;
+			nbEvents = 0;
+		}
+	}
+	if (nbEvents > 0)
+	{
+		return emCircularRecorderWrite(fd, batch, nbEvents * sizeof(CBRecEvent_t));
+	}
+	return CB_true;
+}
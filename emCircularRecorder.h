@@ -0,0 +1,136 @@
+/*
+ * @file emCircularRecorder.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a per-thread flight recorder built on emCircularBuffer.
+ *
+ * Every thread records its events in its own circular buffer in overwrite mode,
+ * so the recording never blocks and threads never write in shared memory.
+ * The dump merges the events of all the threads by timestamp and writes them in
+ * a single binary file. The dump only uses write(), so it can be called from a
+ * crash handler too, as long as the buffers do not use the locking mechanism.
+ * The module needs a POSIX system (clock_gettime, write).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARRECORDER_H_
+#define EMCIRCULARRECORDER_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_REC_MAX_THREADS 64	// Maximum number of threads that can record
+#define CB_REC_THREAD_RECORDERS 4 // Recorders whose buffer is remembered by every thread
+#define CB_REC_PAYLOAD_SIZE 16	// Size in bytes of the payload of an event
+#define CB_REC_DUMP_BATCH 64	// Number of events written with a single write()
+
+/*
+ * Definition of the event stored in the buffers and in the dump file
+ */
+typedef struct CBRecEvent_t
+{
+	uint64_t timestamp;							// CLOCK_MONOTONIC time in nanoseconds
+	uint32_t threadId;							// index of the thread in the recorder
+	uint32_t eventId;							// user id of the event
+	unsigned char payload[CB_REC_PAYLOAD_SIZE]; // user data of the event
+} CBRecEvent_t;
+
+/*
+ * Definition of the header of the dump file, followed by the events
+ */
+typedef struct CBRecFileHeader_t
+{
+	char magic[8];			// "EMCREC1", NUL terminated
+	uint32_t eventSize;		// size of every event in the file
+	uint32_t nbThreads;		// number of threads registered in the recorder
+} CBRecFileHeader_t;
+
+/*
+ * Definition of the recorder data type
+ */
+typedef struct CBRecorder_t
+{
+	uint64_t id;							// unique id of the recorder, never reused
+	size_t ringElems;						// number of events of every thread buffer
+	CBuffer_t *rings[CB_REC_MAX_THREADS];	// buffers of the threads registered
+	const void *owners[CB_REC_MAX_THREADS];	// threads that own the buffers
+	size_t nbRings;							// number of buffers reserved
+} CBRecorder_t;
+
+/*
+ * @brief This function initializes the recorder.
+ *
+ * @param ringElems, number of events retained for every thread
+ * @return CBRecorder_t*, pointer to the recorder created. Returns
+ * 		NULL if it was not possible to create the recorder
+ */
+CBRecorder_t *emCircularRecorderInit(const size_t ringElems);
+
+/*
+ * @brief This function deletes the recorder and frees all the buffers.
+ * 		No thread must be recording.
+ *
+ * @param recorder, pointer to the recorder to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularRecorderDelete(CBRecorder_t *recorder);
+
+/*
+ * @brief This function creates the buffer of the calling thread.
+ * 		It is called by emCircularRecord() the first time a thread records,
+ * 		it can be called before to keep the allocation out of the critical path.
+ * 		Every thread keeps one buffer per recorder, also when it records in more
+ * 		recorders. The buffer of a thread that exited can be reused by a later thread.
+ *
+ * @param recorder, pointer to the recorder to be used
+ * @return CBStatus_t, return value. Returns CB_true if the thread has
+ * 		its buffer, CB_error otherwise
+ */
+CBStatus_t emCircularRecorderRegisterThread(CBRecorder_t *recorder);
+
+/*
+ * @brief This function records an event in the buffer of the calling thread,
+ * 		overwriting the oldest event if the buffer is full.
+ *
+ * @param recorder, pointer to the recorder to be used
+ * @param eventId, user id of the event
+ * @param payload, pointer to the user data of the event. Can be NULL
+ * @param size, size of the user data, truncated to CB_REC_PAYLOAD_SIZE
+ * @return CBStatus_t, return value. Returns CB_true if the event was recorded
+ */
+CBStatus_t emCircularRecord(CBRecorder_t *recorder, const uint32_t eventId, const void *payload, size_t size);
+
+/*
+ * @brief This function writes the events of all the threads in fd, ordered
+ * 		by timestamp, after a CBRecFileHeader_t. The events are not removed.
+ * 		It does not allocate memory and only uses write(), so it can be called
+ * 		from a crash handler when the locking mechanism of the buffers is not
+ * 		used: it takes their locks otherwise. Events overwritten while the dump
+ * 		is running are skipped.
+ *
+ * @param recorder, pointer to the recorder to be used
+ * @param fd, file descriptor where the events are written
+ * @return CBStatus_t, return value. Returns CB_true if the dump was written,
+ * 		CB_error if a write failed
+ */
+CBStatus_t emCircularRecorderDump(const CBRecorder_t *recorder, const int fd);
+
+#endif /* EMCIRCULARRECORDER_H_ */
@@ -0,0 +1,288 @@
+/*
+ * @file emCircularReorder.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularReorder.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+#define CB_REORDER_WORD_BITS 64 // number of slots tracked by a word of the bitmap
+
+/*
+ * Counts the slots from seq, up to the end of the window, that have the presence
+ * bit equal to present, reading a whole word of the bitmap at every step
+ */
+static size_t emCircularReorderRun(const CBReorder_t *reorder, uint64_t seq, const int present)
+{
+	size_t retval = 0;
+	while (retval < reorder->capacity)
+	{
+		size_t slot = (size_t)(seq & (reorder->capacity - 1));
+		size_t bit = slot % CB_REORDER_WORD_BITS;
+		uint64_t word = emCircularPort_AtomicLoad(&reorder->present[slot / CB_REORDER_WORD_BITS]);
+		/* The bits set in stop end the run, the zeros shifted in from the top do not */
+		uint64_t stop = (present ? ~word : word) >> bit;
+		if (stop != 0)
+		{
+			retval += emCircularPort_Ctz64(stop);
+			break;
+		}
+		retval += CB_REORDER_WORD_BITS - bit;
+		seq += CB_REORDER_WORD_BITS - bit;
+	}
+	return (retval < reorder->capacity) ? retval : reorder->capacity;
+}
+
+/*
+ * Returns the pointer to the slot of a sequence number
+ */
+static void *emCircularReorderSlot(const CBReorder_t *reorder, const uint64_t seq)
+{
+	return reorder->startBuffer + ((size_t)(seq & (reorder->capacity - 1)) * reorder->elemSize);
+}
+
+/*
+ * Returns the mask of the bit of a sequence number in its word
+ */
+static uint64_t emCircularReorderMask(const CBReorder_t *reorder, const uint64_t seq)
+{
+	return (uint64_t)1 << ((size_t)(seq & (reorder->capacity - 1)) % CB_REORDER_WORD_BITS);
+}
+
+/*
+ * Returns the word of the bitmap of a sequence number
+ */
+static uint64_t *emCircularReorderWord(const CBReorder_t *reorder, const uint64_t seq)
+{
+	return &reorder->present[(size_t)(seq & (reorder->capacity - 1)) / CB_REORDER_WORD_BITS];
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBReorder_t *emCircularReorderInit(const size_t capacity, const size_t elemSize, const uint64_t firstSeq)
+{
+	if ((capacity < CB_REORDER_WORD_BITS) || ((capacity & (capacity - 1)) != 0))
+		return NULL;
+	if (elemSize < 1)
+		return NULL;
+	CBReorder_t *retval = (CBReorder_t *)emCircularPortMalloc(sizeof(CBReorder_t));
+	if (retval == NULL)
+		return NULL;
+	retval->startBuffer = (unsigned char *)emCircularPortMalloc(capacity * elemSize);
+	retval->present = (uint64_t *)emCircularPortMalloc((capacity / CB_REORDER_WORD_BITS) * sizeof(uint64_t));
+	retval->busy = (uint64_t *)emCircularPortMalloc((capacity / CB_REORDER_WORD_BITS) * sizeof(uint64_t));
+	if ((retval->startBuffer == NULL) || (retval->present == NULL) || (retval->busy == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the reorder buffer!\r\n");
+		emCircularReorderDelete(retval);
+		return NULL;
+	}
+	memset(retval->present, 0, (capacity / CB_REORDER_WORD_BITS) * sizeof(uint64_t));
+	memset(retval->busy, 0, (capacity / CB_REORDER_WORD_BITS) * sizeof(uint64_t));
+	retval->elemSize = elemSize;
+	retval->capacity = capacity;
+	retval->nextSeq = firstSeq;
+	retval->windowSeq = firstSeq;
+	CB_DEBUG_Print("CB:\tReorder buffer initialised. Buffer pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularReorderDelete(CBReorder_t *reorder)
+{
+	if (reorder == NULL)
+		return CB_error;
+	if (reorder->startBuffer != NULL)
+		emCircularPortFree(reorder->startBuffer);
+	if (reorder->present != NULL)
+		emCircularPortFree(reorder->present);
+	if (reorder->busy != NULL)
+		emCircularPortFree(reorder->busy);
+	emCircularPortFree(reorder);
+	return CB_true;
+}
+
+CBStatus_t emCircularReorderInsert(CBReorder_t *reorder, const uint64_t seq, const void *elem)
+{
+	if (reorder == NULL)
+		return CB_error;
+	return emCircularReorderInsertParts(reorder, seq, elem, reorder->elemSize, NULL);
+}
+
+CBStatus_t emCircularReorderInsertParts(CBReorder_t *reorder, const uint64_t seq, const void *first,
+										const size_t firstSize, const void *second)
+{
+	if ((reorder == NULL) || (first == NULL) || (firstSize > reorder->elemSize))
+		return CB_error;
+	if ((second == NULL) && (firstSize < reorder->elemSize))
+		return CB_error;
+	uint64_t nextSeq = emCircularPort_AtomicLoad(&reorder->nextSeq);
+	uint64_t windowSeq = emCircularPort_AtomicLoad(&reorder->windowSeq);
+	if ((seq < nextSeq) || ((seq - windowSeq) >= reorder->capacity))
+	{
+		CB_DEBUG_Print("CB:\tSequence number out of the reorder window.\r\n");
+		return CB_false;
+	}
+	size_t wordInd = (size_t)(seq & (reorder->capacity - 1)) / CB_REORDER_WORD_BITS;
+	uint64_t *word = &reorder->present[wordInd];
+	uint64_t mask = emCircularReorderMask(reorder, seq);
+	if ((emCircularPort_AtomicLoad(word) & mask) != 0)
+	{
+		CB_DEBUG_Print("CB:\tDuplicated sequence number.\r\n");
+		return CB_false;
+	}
+	/* The slot is claimed before the copy, so no other producer writes it at the same time */
+	if ((emCircularPort_AtomicFetchOr(&reorder->busy[wordInd], mask) & mask) != 0)
+	{
+		CB_DEBUG_Print("CB:\tSequence number being inserted by another producer.\r\n");
+		return CB_false;
+	}
+	CBStatus_t retval = CB_false;
+	nextSeq = emCircularPort_AtomicLoad(&reorder->nextSeq);
+	if ((seq >= nextSeq) && ((emCircularPort_AtomicLoad(word) & mask) == 0))
+	{
+		unsigned char *slot = (unsigned char *)emCircularReorderSlot(reorder, seq);
+		memcpy(slot, first, firstSize);
+		if (firstSize < reorder->elemSize)
+		{
+			memcpy(slot + firstSize, second, reorder->elemSize - firstSize);
+		}
+		emCircularPort_AtomicFetchOr(word, mask);
+		retval = CB_true;
+		/*
+		 * The consumer moves nextSeq before clearing the bits it skips. If seq was
+		 * skipped during the copy and the bit is still set, the skip cleared it
+		 * before it was set, so it is removed here; if it is clear, the element
+		 * was already taken or skipped after it was inserted. The slot cannot be
+		 * reused meanwhile, the busy bit is still set
+		 */
+		emCircularPort_AtomicFence();
+		if (seq < emCircularPort_AtomicLoad(&reorder->nextSeq))
+		{
+			if ((emCircularPort_AtomicFetchAnd(word, ~mask) & mask) != 0)
+			{
+				CB_DEBUG_Print("CB:\tSequence number skipped while inserted.\r\n");
+				retval = CB_false;
+			}
+		}
+	}
+	emCircularPort_AtomicFetchAnd(&reorder->busy[wordInd], ~mask);
+	return retval;
+}
+
+size_t emCircularReorderReady(const CBReorder_t *reorder)
+{
+	if (reorder == NULL)
+		return 0;
+	return emCircularReorderRun(reorder, reorder->nextSeq, 1);
+}
+
+void *emCircularReorderPeekTail(const CBReorder_t *reorder, uint64_t *seq)
+{
+	if (reorder == NULL)
+		return NULL;
+	uint64_t nextSeq = reorder->nextSeq;
+	if ((emCircularPort_AtomicLoad(emCircularReorderWord(reorder, nextSeq)) &
+		 emCircularReorderMask(reorder, nextSeq)) == 0)
+		return NULL;
+	if (seq != NULL)
+	{
+		*seq = nextSeq;
+	}
+	return emCircularReorderSlot(reorder, nextSeq);
+}
+
+void *emCircularReorderGetTail(CBReorder_t *reorder, uint64_t *seq)
+{
+	void *retval = emCircularReorderPeekTail(reorder, seq);
+	if (retval == NULL)
+		return NULL;
+	uint64_t nextSeq = reorder->nextSeq;
+	emCircularPort_AtomicFetchAnd(emCircularReorderWord(reorder, nextSeq), ~emCircularReorderMask(reorder, nextSeq));
+	emCircularPort_AtomicStore(&reorder->nextSeq, nextSeq + 1);
+	emCircularPort_AtomicStore(&reorder->windowSeq, nextSeq + 1);
+	return retval;
+}
+
+CBStatus_t emCircularReorderNextPresent(const CBReorder_t *reorder, uint64_t *seq)
+{
+	if ((reorder == NULL) || (seq == NULL))
+		return CB_error;
+	size_t gap = emCircularReorderRun(reorder, reorder->nextSeq, 0);
+	if (gap == reorder->capacity)
+		return CB_false;
+	*seq = reorder->nextSeq + gap;
+	return CB_true;
+}
+
+CBStatus_t emCircularReorderSkip(CBReorder_t *reorder, const uint64_t seq)
+{
+	if (reorder == NULL)
+		return CB_error;
+	uint64_t nextSeq = reorder->nextSeq;
+	if (seq < nextSeq)
+		return CB_false;
+	/* Clears the bits of the slots left, a whole word at every step */
+	uint64_t left = seq - nextSeq;
+	if (left > reorder->capacity)
+	{
+		left = reorder->capacity;
+	}
+	/*
+	 * nextSeq is moved first, so an insert racing with the skip sees it (see
+	 * emCircularReorderInsertParts()), and the window of the producers only after
+	 * the bits are cleared, so no element of the next lap is inserted before
+	 */
+	emCircularPort_AtomicStore(&reorder->nextSeq, seq);
+	emCircularPort_AtomicFence();
+	while (left > 0)
+	{
+		size_t bit = (size_t)(nextSeq & (reorder->capacity - 1)) % CB_REORDER_WORD_BITS;
+		size_t nbBits = CB_REORDER_WORD_BITS - bit;
+		if (nbBits > left)
+		{
+			nbBits = (size_t)left;
+		}
+		uint64_t mask = (nbBits == CB_REORDER_WORD_BITS) ? ~(uint64_t)0 : ((((uint64_t)1 << nbBits) - 1) << bit);
+		emCircularPort_AtomicFetchAnd(emCircularReorderWord(reorder, nextSeq), ~mask);
+		nextSeq += nbBits;
+		left -= nbBits;
+	}
+	emCircularPort_AtomicStore(&reorder->windowSeq, seq);
+	return CB_true;
+}
+
+uint64_t emCircularReorderGetNextSeq(const CBReorder_t *reorder)
+{
+	if (reorder == NULL)
+		return 0;
+	return emCircularPort_AtomicLoad(&reorder->nextSeq);
+}
@@ -0,0 +1,166 @@
+/*
+ * @file emCircularReorder.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a reorder buffer for elements with a sequence number.
+ *
+ * Producers insert the elements at any sequence number inside a window of
+ * capacity elements that starts from the next sequence number expected by the
+ * consumer (slot = seq modulo capacity), so elements received out of order are
+ * reassembled in place. The consumer only takes the contiguous prefix in order.
+ * A presence bitmap tracks the slots filled: the contiguous prefix and the next
+ * element after a gap are found with a count of trailing zeros on whole words.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARREORDER_H_
+#define EMCIRCULARREORDER_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the reorder buffer data type
+ */
+typedef struct CBReorder_t
+{
+	unsigned char *startBuffer; // memory of the elements
+	size_t elemSize;			// dimension of the elements of the buffer
+	size_t capacity;			// number of elements of the window, a power of two
+	uint64_t *present;			// presence bitmap, one bit for every slot
+	uint64_t *busy;				// bitmap of the slots being written by a producer
+	uint64_t nextSeq;			// sequence number of the next element to be taken
+	uint64_t windowSeq;			// start of the window of the producers, moved after the
+								// slots left by the consumer are cleared
+} CBReorder_t;
+
+/*
+ * @brief This function initializes the reorder buffer.
+ *
+ * @param capacity, number of elements of the window. Must be a power
+ * 		of two, not lower than 64
+ * @param elemSize, size of every element in terms of bytes
+ * @param firstSeq, sequence number of the first element expected
+ * @return CBReorder_t*, pointer to the reorder buffer created. Returns
+ * 		NULL if it was not possible to create the reorder buffer
+ */
+CBReorder_t *emCircularReorderInit(const size_t capacity, const size_t elemSize, const uint64_t firstSeq);
+
+/*
+ * @brief This function deletes the reorder buffer and frees its memory.
+ *
+ * @param reorder, pointer to the reorder buffer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularReorderDelete(CBReorder_t *reorder);
+
+/*
+ * @brief This function copies an element in the slot of its sequence number.
+ * 		Many producers can insert at the same time, also while the consumer
+ * 		takes or skips elements: an element whose sequence number is skipped
+ * 		while it is copied is dropped.
+ *
+ * @param reorder, pointer to the reorder buffer to be used
+ * @param seq, sequence number of the element
+ * @param elem, pointer to the element to be copied
+ * @return CBStatus_t, return value. Returns CB_true if the element was inserted,
+ * 		CB_false if seq was already taken, is a duplicate, is being inserted by
+ * 		another producer or is out of the window
+ */
+CBStatus_t emCircularReorderInsert(CBReorder_t *reorder, const uint64_t seq, const void *elem);
+
+/*
+ * @brief This function works like emCircularReorderInsert() for an element
+ * 		made of two parts, e.g. a header and a payload, copied one after the
+ * 		other in the slot without building the element first.
+ *
+ * @param reorder, pointer to the reorder buffer to be used
+ * @param seq, sequence number of the element
+ * @param first, pointer to the first part of the element
+ * @param firstSize, size of the first part, not greater than the element size
+ * @param second, pointer to the rest of the element. Can be NULL if
+ * 		firstSize is the element size
+ * @return CBStatus_t, return value. Returns CB_true if the element was inserted,
+ * 		CB_false if seq was already taken, is a duplicate or is beyond the window
+ */
+CBStatus_t emCircularReorderInsertParts(CBReorder_t *reorder, const uint64_t seq, const void *first,
+										const size_t firstSize, const void *second);
+
+/*
+ * @brief This function returns the number of elements that can be taken
+ * 		in order, i.e. the length of the contiguous prefix of the window.
+ *
+ * @param reorder, pointer to the reorder buffer to be checked
+ * @return size_t, number of elements ready
+ */
+size_t emCircularReorderReady(const CBReorder_t *reorder);
+
+/*
+ * @brief This function returns the next element in order without taking it.
+ *
+ * @param reorder, pointer to the reorder buffer to be used
+ * @param seq, pointer where the sequence number of the element is stored. Can be NULL
+ * @return void*, pointer to the element. Returns NULL if the next
+ * 		element was not inserted yet
+ */
+void *emCircularReorderPeekTail(const CBReorder_t *reorder, uint64_t *seq);
+
+/*
+ * @brief This function takes the next element in order. As for emCircularGetTail()
+ * 		the slot is released, so the element must be used before a producer
+ * 		can insert the sequence number capacity elements later.
+ *
+ * @param reorder, pointer to the reorder buffer to be used
+ * @param seq, pointer where the sequence number of the element is stored. Can be NULL
+ * @return void*, pointer to the element. Returns NULL if the next
+ * 		element was not inserted yet
+ */
+void *emCircularReorderGetTail(CBReorder_t *reorder, uint64_t *seq);
+
+/*
+ * @brief This function finds the first element inserted in the window,
+ * 		i.e. the end of the gap at the start of the window.
+ *
+ * @param reorder, pointer to the reorder buffer to be checked
+ * @param seq, pointer where the sequence number of the element is stored
+ * @return CBStatus_t, return value. Returns CB_true if an element was found,
+ * 		CB_false if the window is empty
+ */
+CBStatus_t emCircularReorderNextPresent(const CBReorder_t *reorder, uint64_t *seq);
+
+/*
+ * @brief This function moves the start of the window to seq, giving up on
+ * 		the missing elements before it. The elements inserted before seq are dropped.
+ *
+ * @param reorder, pointer to the reorder buffer to be used
+ * @param seq, sequence number of the next element to be taken
+ * @return CBStatus_t, return value. Returns CB_true if the window was moved,
+ * 		CB_false if seq is before the start of the window
+ */
+CBStatus_t emCircularReorderSkip(CBReorder_t *reorder, const uint64_t seq);
+
+/*
+ * @brief This function returns the sequence number of the next element
+ * 		to be taken, i.e. the start of the window.
+ *
+ * @param reorder, pointer to the reorder buffer to be checked
+ * @return uint64_t, sequence number of the next element
+ */
+uint64_t emCircularReorderGetNextSeq(const CBReorder_t *reorder);
+
+#endif /* EMCIRCULARREORDER_H_ */
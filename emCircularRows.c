@@ -0,0 +1,134 @@
+/*
+ * @file emCircularRows.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularRows.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBRows_t *emCircularRowsInit(const size_t nbRows, const size_t rowElems, const size_t elemSize, const size_t windowRows)
+{
+	if ((nbRows < 1) || (rowElems < 1) || (elemSize < 1))
+		return NULL;
+	if (windowRows > nbRows)
+		return NULL;
+	CBRows_t *retval = (CBRows_t *)emCircularPortMalloc(sizeof(CBRows_t));
+	if (retval == NULL)
+		return NULL;
+	retval->rowSize = rowElems * elemSize;
+	retval->stride = (retval->rowSize + CB_ROWS_ALIGN - 1) & ~((size_t)CB_ROWS_ALIGN - 1);
+	retval->nbRows = nbRows;
+	/* A window of W rows starting at the last row needs the first W - 1 rows again */
+	retval->mirrorRows = (windowRows > 1) ? (windowRows - 1) : 0;
+	retval->headCount = 0;
+	retval->memory = (unsigned char *)emCircularPortMalloc(((nbRows + retval->mirrorRows) * retval->stride) + CB_ROWS_ALIGN - 1);
+	if (retval->memory == NULL)
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the rows!\r\n");
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	retval->startBuffer = (unsigned char *)(((uintptr_t)retval->memory + CB_ROWS_ALIGN - 1) & ~((uintptr_t)CB_ROWS_ALIGN - 1));
+	memset(retval->startBuffer, 0, (nbRows + retval->mirrorRows) * retval->stride);
+	CB_DEBUG_Print("CB:\tRows buffer initialised. Rows pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularRowsDelete(CBRows_t *rows)
+{
+	if (rows == NULL)
+		return CB_error;
+	emCircularPortFree(rows->memory);
+	emCircularPortFree(rows);
+	return CB_true;
+}
+
+void *emCircularRowsGetHead(CBRows_t *rows)
+{
+	if (rows == NULL)
+		return NULL;
+	return rows->startBuffer + ((size_t)(rows->headCount % rows->nbRows) * rows->stride);
+}
+
+CBStatus_t emCircularRowsPublish(CBRows_t *rows)
+{
+	if (rows == NULL)
+		return CB_error;
+	size_t index = (size_t)(rows->headCount % rows->nbRows);
+	if (index < rows->mirrorRows)
+	{
+		memcpy(rows->startBuffer + ((rows->nbRows + index) * rows->stride),
+			   rows->startBuffer + (index * rows->stride), rows->rowSize);
+	}
+	rows->headCount++;
+	return CB_true;
+}
+
+CBStatus_t emCircularRowsPush(CBRows_t *rows, const void *row)
+{
+	if ((rows == NULL) || (row == NULL))
+		return CB_error;
+	memcpy(emCircularRowsGetHead(rows), row, rows->rowSize);
+	return emCircularRowsPublish(rows);
+}
+
+size_t emCircularRowsGetWindow(const CBRows_t *rows, size_t nbRows, CBSpan_t *view)
+{
+	if ((rows == NULL) || (view == NULL))
+		return 0;
+	size_t available = emCircularRowsGetNbRows(rows);
+	if (nbRows > available)
+	{
+		nbRows = available;
+	}
+	size_t first = (size_t)((rows->headCount - nbRows) % rows->nbRows);
+	size_t firstNbRows = rows->nbRows - first;
+	/* The mirror holds the rows after the end of the buffer */
+	if ((firstNbRows + rows->mirrorRows) >= nbRows)
+	{
+		firstNbRows = nbRows;
+	}
+	view->first = (nbRows > 0) ? (rows->startBuffer + (first * rows->stride)) : NULL;
+	view->firstNbElems = firstNbRows;
+	view->second = (firstNbRows < nbRows) ? rows->startBuffer : NULL;
+	view->secondNbElems = nbRows - firstNbRows;
+	return nbRows;
+}
+
+size_t emCircularRowsGetNbRows(const CBRows_t *rows)
+{
+	if (rows == NULL)
+		return 0;
+	return (rows->headCount < rows->nbRows) ? (size_t)rows->headCount : rows->nbRows;
+}
@@ -0,0 +1,130 @@
+/*
+ * @file emCircularRows.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a two-dimensional scrolling buffer of rows.
+ *
+ * Every element of the buffer is a row of elements (e.g. a spectrum or an image
+ * line); a new row overwrites the oldest one, and the last rows are read as a
+ * rectangular window without copying. The rows are stored with a stride aligned
+ * to CB_ROWS_ALIGN bytes, so row-wise SIMD kernels can work in place. When a window
+ * size is given the storage is mirrored: the first rows are written twice, also
+ * after the end of the buffer, so any window up to that size is contiguous in
+ * memory. Otherwise a window is made of two contiguous parts.
+ * The buffer is not thread safe, it must be used by a single thread or the
+ * caller must protect it.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARROWS_H_
+#define EMCIRCULARROWS_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_ROWS_ALIGN 64 // alignment in bytes of every row, must be a power of two
+
+/*
+ * Definition of the rows buffer data type
+ */
+typedef struct CBRows_t
+{
+	unsigned char *memory;		// memory allocated
+	unsigned char *startBuffer; // first row, aligned to CB_ROWS_ALIGN
+	size_t rowSize;				// size in bytes of a row
+	size_t stride;				// distance in bytes between two rows
+	size_t nbRows;				// number of rows retained
+	size_t mirrorRows;			// number of rows written again after the end of the buffer
+	uint64_t headCount;			// number of rows pushed
+} CBRows_t;
+
+/*
+ * @brief This function initializes the rows buffer allocating its memory.
+ *
+ * @param nbRows, number of rows retained
+ * @param rowElems, number of elements of every row
+ * @param elemSize, size of every element in terms of bytes
+ * @param windowRows, maximum number of rows of a contiguous window, not greater
+ * 		than nbRows. If 0 the storage is not mirrored and the windows can wrap
+ * @return CBRows_t*, pointer to the rows buffer created. Returns
+ * 		NULL if it was not possible to create the rows buffer
+ */
+CBRows_t *emCircularRowsInit(const size_t nbRows, const size_t rowElems, const size_t elemSize, const size_t windowRows);
+
+/*
+ * @brief This function deletes the rows buffer and frees its memory.
+ *
+ * @param rows, pointer to the rows buffer to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularRowsDelete(CBRows_t *rows);
+
+/*
+ * @brief This function returns the row to be written in place by the caller.
+ * 		The row is added with emCircularRowsPublish(), until then the same row
+ * 		is returned. The row holds the content of the oldest row.
+ *
+ * @param rows, pointer to the rows buffer to be used
+ * @return void*, pointer to the row
+ */
+void *emCircularRowsGetHead(CBRows_t *rows);
+
+/*
+ * @brief This function adds the row written after emCircularRowsGetHead(),
+ * 		overwriting the oldest row. The row is copied in the mirror if needed.
+ *
+ * @param rows, pointer to the rows buffer to be used
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularRowsPublish(CBRows_t *rows);
+
+/*
+ * @brief This function copies a row in the buffer, overwriting the oldest row.
+ *
+ * @param rows, pointer to the rows buffer to be used
+ * @param row, pointer to the row to be copied
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularRowsPush(CBRows_t *rows, const void *row);
+
+/*
+ * @brief This function returns the window of the last rows, from the oldest
+ * 		to the newest, with rows->stride bytes between two rows. With mirrored
+ * 		storage the window is contiguous if it is not larger than the window
+ * 		size given to emCircularRowsInit(). The view is valid until the next push.
+ *
+ * @param rows, pointer to the rows buffer to be used
+ * @param nbRows, number of rows of the window
+ * @param view, filled with the parts of the window, in terms of rows
+ * @return size_t, number of rows of the window, lower than nbRows if
+ * 		less rows were pushed
+ */
+size_t emCircularRowsGetWindow(const CBRows_t *rows, size_t nbRows, CBSpan_t *view);
+
+/*
+ * @brief This function returns the number of rows that can be read.
+ *
+ * @param rows, pointer to the rows buffer to be checked
+ * @return size_t, number of rows
+ */
+size_t emCircularRowsGetNbRows(const CBRows_t *rows);
+
+#endif /* EMCIRCULARROWS_H_ */
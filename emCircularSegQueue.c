@@ -0,0 +1,299 @@
+/*
+ * @file emCircularSegQueue.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularSegQueue.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+#define CB_SEGQUEUE_ALIGN 16 // alignment of the elements storage of a segment
+
+/*
+ * Prepares a segment to be linked at the end of the queue
+ */
+static void emCircularSegmentReset(const CBSegQueue_t *queue, CBSegment_t *seg)
+{
+	seg->next = NULL;
+	seg->reserveInd = 0;
+	seg->readInd = 0;
+	memset(seg->ready, 0, queue->segElems);
+}
+
+/*
+ * Allocates a segment with a single allocation for the header,
+ * the ready flags and the elements storage
+ */
+static CBSegment_t *emCircularSegmentAlloc(const CBSegQueue_t *queue)
+{
+	size_t dataOffset = sizeof(CBSegment_t) + queue->segElems;
+	dataOffset = (dataOffset + CB_SEGQUEUE_ALIGN - 1) & ~((size_t)CB_SEGQUEUE_ALIGN - 1);
+	unsigned char *mem = (unsigned char *)emCircularPortMalloc(dataOffset + (queue->segElems * queue->elemSize));
+	if (mem == NULL)
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate a new segment!\r\n");
+		return NULL;
+	}
+	CBSegment_t *seg = (CBSegment_t *)mem;
+	seg->ready = mem + sizeof(CBSegment_t);
+	seg->startBuffer = mem + dataOffset;
+	emCircularSegmentReset(queue, seg);
+	return seg;
+}
+
+/*
+ * Pushes a free segment in the pool. Many threads can push at the same time.
+ */
+static void emCircularSegmentPoolPush(CBSegQueue_t *queue, CBSegment_t *seg)
+{
+	CBSegment_t *top = emCircularPort_AtomicLoad(&queue->pool);
+	do
+	{
+		seg->next = top;
+	} while (!emCircularPort_AtomicCAS(&queue->pool, &top, seg));
+}
+
+/*
+ * Takes a free segment from the pool. A single thread at a time can pop, the
+ * others get NULL and allocate a segment: with one popper the top segment cannot
+ * be removed and pushed back while the popper reads its next pointer, so the
+ * stack is not exposed to the ABA problem. The pushes stay lock-free.
+ */
+static CBSegment_t *emCircularSegmentPoolPop(CBSegQueue_t *queue)
+{
+	size_t popping = 0;
+	if (!emCircularPort_AtomicCAS(&queue->poolPopping, &popping, 1))
+		return NULL;
+	CBSegment_t *seg = emCircularPort_AtomicLoad(&queue->pool);
+	while (seg != NULL)
+	{
+		CBSegment_t *next = seg->next;
+		if (emCircularPort_AtomicCAS(&queue->pool, &seg, next))
+		{
+			seg->next = NULL;
+			break;
+		}
+	}
+	emCircularPort_AtomicStore(&queue->poolPopping, 0);
+	return seg;
+}
+
+/*
+ * Returns the segment following seg, linking a new one if it does not exist yet.
+ * The linker is the producer that reserved the first slot after the end of seg;
+ * the others wait for it a little and then try to link a segment by themselves,
+ * so that a failure or a preemption of the linker does not block them. The segment
+ * is taken from the pool when possible, and given back if another one was linked.
+ */
+static CBSegment_t *emCircularSegmentGetNext(CBSegQueue_t *queue, CBSegment_t *seg, const int isLinker)
+{
+	CBSegment_t *next = emCircularPort_AtomicLoad(&seg->next);
+	for (size_t spin = 0; (next == NULL) && (!isLinker) && (spin < CB_SEGQUEUE_SPIN); spin++)
+	{
+		emCircularPort_CpuRelax();
+		next = emCircularPort_AtomicLoad(&seg->next);
+	}
+	if (next != NULL)
+		return next;
+
+	CBSegment_t *newSeg = emCircularSegmentPoolPop(queue);
+	if (newSeg == NULL)
+	{
+		newSeg = emCircularSegmentAlloc(queue);
+	}
+	if (newSeg == NULL)
+		return NULL;
+	if (emCircularPort_AtomicCAS(&seg->next, &next, newSeg))
+		return newSeg;
+	emCircularSegmentPoolPush(queue, newSeg);
+	return next;
+}
+
+/*
+ * Moves the consumed segments in the pool. In MPSC mode a late producer can still
+ * be reading a segment, so the consumed segments are kept linked to the queue and
+ * recycled with an epoch scheme. The epoch moves on only when every producer inside
+ * a push entered in the current one, so a producer that entered in epoch e has left
+ * before epoch e + 2. A segment consumed in epoch e can still be the last segment
+ * for the producers until its linker leaves, i.e. for producers entering up to epoch
+ * e + 1, so it is recycled from epoch e + 3, when they have all left.
+ */
+static void emCircularSegmentRetire(CBSegQueue_t *queue, CBSegment_t *seg)
+{
+	seg->retireEpoch = queue->epoch;
+	if (queue->retired == NULL)
+	{
+		queue->retired = seg;
+	}
+	if (queue->mode == CB_SegQueueMPSC)
+	{
+		emCircularPort_AtomicFence();
+		if (emCircularPort_AtomicLoad(&queue->activeProducers[(queue->epoch + 1) % 2]) == 0)
+		{
+			emCircularPort_AtomicStore(&queue->epoch, queue->epoch + 1);
+		}
+	}
+	seg = queue->retired;
+	while ((seg != queue->headSeg) &&
+		   ((queue->mode != CB_SegQueueMPSC) || ((seg->retireEpoch + 3) <= queue->epoch)))
+	{
+		CBSegment_t *next = seg->next;
+		emCircularSegmentReset(queue, seg);
+		emCircularSegmentPoolPush(queue, seg);
+		seg = next;
+	}
+	queue->retired = (seg != queue->headSeg) ? seg : NULL;
+}
+
+/*
+ * Frees a list of segments linked through the next pointer
+ */
+static void emCircularSegmentFreeList(CBSegment_t *seg)
+{
+	while (seg != NULL)
+	{
+		CBSegment_t *next = seg->next;
+		emCircularPortFree(seg);
+		seg = next;
+	}
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBSegQueue_t *emCircularSegQueueInit(const size_t segElems, const size_t elemSize, const CBSegQueueMode_t mode)
+{
+	if (segElems < 1)
+		return NULL;
+	if (elemSize < 1)
+		return NULL;
+	CBSegQueue_t *retval = (CBSegQueue_t *)emCircularPortMalloc(sizeof(CBSegQueue_t));
+	if (retval == NULL)
+		return NULL;
+	retval->segElems = segElems;
+	retval->elemSize = elemSize;
+	retval->mode = mode;
+	retval->pool = NULL;
+	retval->poolPopping = 0;
+	retval->retired = NULL;
+	retval->epoch = 0;
+	retval->activeProducers[0] = 0;
+	retval->activeProducers[1] = 0;
+	retval->headSeg = emCircularSegmentAlloc(retval);
+	retval->tailSeg = retval->headSeg;
+	if (retval->headSeg == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	CB_DEBUG_Print("CB:\tSegmented queue initialised. Queue pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularSegQueueDelete(CBSegQueue_t *queue)
+{
+	if (queue == NULL)
+		return CB_error;
+	emCircularSegmentFreeList((queue->retired != NULL) ? queue->retired : queue->headSeg);
+	emCircularSegmentFreeList(queue->pool);
+	emCircularPortFree(queue);
+	return CB_true;
+}
+
+CBStatus_t emCircularSegQueuePush(CBSegQueue_t *queue, const void *elem)
+{
+	if ((queue == NULL) || (elem == NULL))
+		return CB_error;
+	CBStatus_t retval = CB_error;
+	size_t epoch = 0;
+	if (queue->mode == CB_SegQueueMPSC)
+	{
+		/* The epoch is checked again once counted, the consumer can move it on meanwhile */
+		for (;;)
+		{
+			epoch = emCircularPort_AtomicLoad(&queue->epoch);
+			emCircularPort_AtomicFetchAdd(&queue->activeProducers[epoch % 2], 1);
+			if (emCircularPort_AtomicLoad(&queue->epoch) == epoch)
+				break;
+			emCircularPort_AtomicFetchSub(&queue->activeProducers[epoch % 2], 1);
+		}
+	}
+	for (;;)
+	{
+		CBSegment_t *seg = emCircularPort_AtomicLoad(&queue->tailSeg);
+		size_t index;
+		if (queue->mode == CB_SegQueueMPSC)
+		{
+			index = emCircularPort_AtomicFetchAdd(&seg->reserveInd, 1);
+		}
+		else
+		{
+			index = seg->reserveInd++;
+		}
+		if (index < queue->segElems)
+		{
+			memcpy(seg->startBuffer + (index * queue->elemSize), elem, queue->elemSize);
+			emCircularPort_AtomicStore(&seg->ready[index], 1);
+			retval = CB_true;
+			break;
+		}
+		CBSegment_t *next = emCircularSegmentGetNext(queue, seg, index == queue->segElems);
+		if (next == NULL)
+			break;
+		emCircularPort_AtomicCAS(&queue->tailSeg, &seg, next);
+	}
+	if (queue->mode == CB_SegQueueMPSC)
+	{
+		emCircularPort_AtomicFetchSub(&queue->activeProducers[epoch % 2], 1);
+	}
+	return retval;
+}
+
+CBStatus_t emCircularSegQueuePop(CBSegQueue_t *queue, void *elem)
+{
+	if ((queue == NULL) || (elem == NULL))
+		return CB_error;
+	CBSegment_t *seg = queue->headSeg;
+	if (seg->readInd == queue->segElems)
+	{
+		CBSegment_t *next = emCircularPort_AtomicLoad(&seg->next);
+		if (next == NULL)
+			return CB_false;
+		queue->headSeg = next;
+		emCircularSegmentRetire(queue, seg);
+		seg = next;
+	}
+	size_t index = seg->readInd;
+	if (emCircularPort_AtomicLoad(&seg->ready[index]) == 0)
+		return CB_false;
+	memcpy(elem, seg->startBuffer + (index * queue->elemSize), queue->elemSize);
+	seg->readInd = index + 1;
+	return CB_true;
+}
@@ -0,0 +1,126 @@
+/*
+ * @file emCircularSegQueue.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements an unbounded FIFO queue made of a chain of
+ * fixed-size segments.
+ *
+ * When the last segment is full a new one is linked after it, so the queue grows
+ * without copying the elements already stored. Consumed segments are recycled
+ * through a pool of free segments. The queue is lock-free and can be used by one
+ * producer and one consumer (CB_SegQueueSPSC) or by many producers and one
+ * consumer (CB_SegQueueMPSC).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARSEGQUEUE_H_
+#define EMCIRCULARSEGQUEUE_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_SEGQUEUE_SPIN 1024 // Number of retries of a producer waiting for the next segment
+							  // before linking one by itself
+
+/*
+ * Definition of the concurrency modes of the queue
+ */
+typedef enum
+{
+	CB_SegQueueSPSC,	// single producer, single consumer
+	CB_SegQueueMPSC		// multiple producers, single consumer
+} CBSegQueueMode_t;
+
+/*
+ * Definition of the segment data type
+ */
+typedef struct CBSegment_t
+{
+	struct CBSegment_t *next;	// next segment of the queue or of the pool
+	size_t reserveInd;			// index of the next slot to be reserved by the producers
+	size_t readInd;				// index of the next slot to be read by the consumer
+	size_t retireEpoch;			// epoch of the producers when the segment was consumed
+	unsigned char *ready;		// flags set by the producers when a slot is written
+	unsigned char *startBuffer; // pointer of the first element of the segment
+} CBSegment_t;
+
+/*
+ * Definition of the segmented queue data type
+ */
+typedef struct CBSegQueue_t
+{
+	CBSegment_t *headSeg;		// segment read by the consumer
+	CBSegment_t *tailSeg;		// segment written by the producers
+	CBSegment_t *pool;			// stack of the free segments
+	size_t poolPopping;			// set while a producer takes a segment from the pool
+	CBSegment_t *retired;		// consumed segments still reachable by the producers
+	size_t segElems;			// dimension of a segment in terms of number of elements
+	size_t elemSize;			// dimension of the elements of the queue
+	size_t epoch;				// epoch of the producers, advanced by the consumer (MPSC only)
+	size_t activeProducers[2];	// number of producers inside a push, by parity of the epoch
+								// they entered in (MPSC only)
+	CBSegQueueMode_t mode;		// concurrency mode of the queue
+} CBSegQueue_t;
+
+/*
+ * @brief This function initializes the segmented queue allocating its first segment.
+ *
+ * @param segElems, number of elements of every segment
+ * @param elemSize, size of every element in terms of bytes
+ * @param mode, concurrency mode of the queue
+ * @return CBSegQueue_t*, pointer to the queue created. Returns
+ * 		NULL if it was not possible to create the queue
+ */
+CBSegQueue_t *emCircularSegQueueInit(const size_t segElems, const size_t elemSize, const CBSegQueueMode_t mode);
+
+/*
+ * @brief This function deletes the queue and frees all its segments.
+ * 		No producer or consumer must be using the queue.
+ *
+ * @param queue, pointer to the queue to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularSegQueueDelete(CBSegQueue_t *queue);
+
+/*
+ * @brief This function copies an element at the end of the queue.
+ * 		A new segment is taken from the pool, or allocated, when the
+ * 		last segment is full, so the push fails only if there is no memory.
+ *
+ * @param queue, pointer to the queue to be used
+ * @param elem, pointer to the element to be copied
+ * @return CBStatus_t, return value. Returns CB_true if the element was
+ * 		pushed, CB_error if it was not possible to allocate a segment
+ */
+CBStatus_t emCircularSegQueuePush(CBSegQueue_t *queue, const void *elem);
+
+/*
+ * @brief This function copies the first element of the queue and removes it.
+ * 		Must be called by the consumer only.
+ *
+ * @param queue, pointer to the queue to be used
+ * @param elem, pointer where the element is copied
+ * @return CBStatus_t, return value. Returns CB_true if an element was
+ * 		taken, CB_false if the queue is empty
+ */
+CBStatus_t emCircularSegQueuePop(CBSegQueue_t *queue, void *elem);
+
+#endif /* EMCIRCULARSEGQUEUE_H_ */
@@ -0,0 +1,244 @@
+/*
+ * @file emCircularWaiter.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // syscall
+#endif
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "emCircularWaiter.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Moves the futex word forward and wakes the sleepers
+ */
+static void emCircularWaiterSignal(CBWaiter_t *waiter)
+{
+	emCircularPort_AtomicFetchAdd(&waiter->futexWord, 1);
+	syscall(SYS_futex, &waiter->futexWord, FUTEX_WAKE_PRIVATE, 0x7fffffff, NULL, NULL, 0);
+}
+
+/*
+ * Notify callback installed on the buffers registered. The fence pairs with the one
+ * of emCircularWaiterWait() between incrementing nbSleepers and checking the buffers:
+ * either the sleeper sees the change of the buffer or the producer sees the sleeper.
+ * It only uses atomics and a system call, so it is async-signal-safe.
+ */
+static void emCircularWaiterCallback(CBuffer_t *buffer, CBEvent_t event, void *arg)
+{
+	(void)buffer;
+	(void)event;
+	CBWaiter_t *waiter = (CBWaiter_t *)arg;
+	emCircularPort_AtomicFence();
+	if (emCircularPort_AtomicLoad(&waiter->nbSleepers) == 0)
+		return;
+	emCircularWaiterSignal(waiter);
+}
+
+/*
+ * Checks the buffers registered and fills the ready arrays
+ */
+static size_t emCircularWaiterScan(const CBWaiter_t *waiter, size_t *ready, uint32_t *readyEvents,
+								   const size_t maxReady)
+{
+	size_t retval = 0;
+	for (size_t i = 0; i < waiter->nbRings; i++)
+	{
+		uint32_t events = 0;
+		if ((waiter->events[i] & CB_WAIT_READABLE) && (emCircularIsEmpty(waiter->rings[i]) == CB_false))
+		{
+			events |= CB_WAIT_READABLE;
+		}
+		if ((waiter->events[i] & CB_WAIT_WRITABLE) && (emCircularIsFull(waiter->rings[i]) == CB_false))
+		{
+			events |= CB_WAIT_WRITABLE;
+		}
+		if (events == 0)
+			continue;
+		if (retval < maxReady)
+		{
+			ready[retval] = i;
+			if (readyEvents != NULL)
+			{
+				readyEvents[retval] = events;
+			}
+		}
+		retval++;
+	}
+	return retval;
+}
+
+/*
+ * Returns the index of a buffer in the waiter, nbRings if it is not registered
+ */
+static size_t emCircularWaiterFind(const CBWaiter_t *waiter, const CBuffer_t *buffer)
+{
+	size_t retval = 0;
+	while ((retval < waiter->nbRings) && (waiter->rings[retval] != buffer))
+	{
+		retval++;
+	}
+	return retval;
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBWaiter_t *emCircularWaiterInit(void)
+{
+	CBWaiter_t *retval = (CBWaiter_t *)emCircularPortMalloc(sizeof(CBWaiter_t));
+	if (retval == NULL)
+		return NULL;
+	memset(retval, 0, sizeof(CBWaiter_t));
+	CB_DEBUG_Print("CB:\tWaiter initialised. Waiter pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularWaiterDelete(CBWaiter_t *waiter)
+{
+	if (waiter == NULL)
+		return CB_error;
+	for (size_t i = 0; i < waiter->nbRings; i++)
+	{
+		emCircularSetNotify(waiter->rings[i], NULL, NULL);
+	}
+	emCircularPortFree(waiter);
+	return CB_true;
+}
+
+CBStatus_t emCircularWaiterAdd(CBWaiter_t *waiter, CBuffer_t *buffer, const uint32_t events)
+{
+	if ((waiter == NULL) || (buffer == NULL))
+		return CB_error;
+	if ((events & (CB_WAIT_READABLE | CB_WAIT_WRITABLE)) == 0)
+		return CB_error;
+	size_t index = emCircularWaiterFind(waiter, buffer);
+	if (index == CB_WAITER_MAX_RINGS)
+	{
+		CB_DEBUG_Print("CB Error:\tToo many buffers registered in the waiter!\r\n");
+		return CB_error;
+	}
+	if (emCircularSetNotify(buffer, emCircularWaiterCallback, waiter) != CB_true)
+		return CB_error;
+	waiter->rings[index] = buffer;
+	waiter->events[index] = events;
+	if (index == waiter->nbRings)
+	{
+		waiter->nbRings++;
+	}
+	return CB_true;
+}
+
+CBStatus_t emCircularWaiterRemove(CBWaiter_t *waiter, CBuffer_t *buffer)
+{
+	if ((waiter == NULL) || (buffer == NULL))
+		return CB_error;
+	size_t index = emCircularWaiterFind(waiter, buffer);
+	if (index == waiter->nbRings)
+		return CB_false;
+	emCircularSetNotify(buffer, NULL, NULL);
+	waiter->nbRings--;
+	memmove(&waiter->rings[index], &waiter->rings[index + 1], (waiter->nbRings - index) * sizeof(CBuffer_t *));
+	memmove(&waiter->events[index], &waiter->events[index + 1], (waiter->nbRings - index) * sizeof(uint32_t));
+	return CB_true;
+}
+
+size_t emCircularWaiterWait(CBWaiter_t *waiter, size_t *ready, uint32_t *readyEvents, const size_t maxReady,
+							const int timeoutMs)
+{
+	if ((waiter == NULL) || ((ready == NULL) && (maxReady > 0)))
+		return 0;
+	size_t retval = emCircularWaiterScan(waiter, ready, readyEvents, maxReady);
+	if ((retval > 0) || (timeoutMs == 0))
+		return retval;
+
+	struct timespec deadline;
+	if (timeoutMs > 0)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeoutMs / 1000;
+		deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+	}
+	uint32_t nbWakeAll = emCircularPort_AtomicLoad(&waiter->nbWakeAll);
+	emCircularPort_AtomicFetchAdd(&waiter->nbSleepers, 1);
+	for (;;)
+	{
+		uint32_t word = emCircularPort_AtomicLoad(&waiter->futexWord);
+		emCircularPort_AtomicFence();
+		retval = emCircularWaiterScan(waiter, ready, readyEvents, maxReady);
+		if ((retval > 0) || (emCircularPort_AtomicLoad(&waiter->nbWakeAll) != nbWakeAll))
+			break;
+		struct timespec timeout;
+		struct timespec *timeoutPtr = NULL;
+		if (timeoutMs > 0)
+		{
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout.tv_sec = deadline.tv_sec - now.tv_sec;
+			timeout.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+			if (timeout.tv_nsec < 0)
+			{
+				timeout.tv_sec--;
+				timeout.tv_nsec += 1000000000L;
+			}
+			if (timeout.tv_sec < 0)
+				break;
+			timeoutPtr = &timeout;
+		}
+		if ((syscall(SYS_futex, &waiter->futexWord, FUTEX_WAIT_PRIVATE, word, timeoutPtr, NULL, 0) != 0) &&
+			(errno == ETIMEDOUT))
+		{
+			retval = emCircularWaiterScan(waiter, ready, readyEvents, maxReady);
+			break;
+		}
+	}
+	emCircularPort_AtomicFetchSub(&waiter->nbSleepers, 1);
+	return retval;
+}
+
+CBStatus_t emCircularWaiterWakeAll(CBWaiter_t *waiter)
+{
+	if (waiter == NULL)
+		return CB_error;
+	emCircularPort_AtomicFetchAdd(&waiter->nbWakeAll, 1);
+	emCircularWaiterSignal(waiter);
+	return CB_true;
+}
@@ -0,0 +1,129 @@
+/*
+ * @file emCircularWaiter.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a waiter that blocks on a set of circular buffers.
+ *
+ * The buffers registered in a waiter notify it with emCircularSetNotify(), so a
+ * consumer serving many buffers can sleep on a single futex word until one of
+ * them becomes readable or writable, instead of polling all of them.
+ * The producers only touch the futex when a thread is actually waiting.
+ * The module needs Linux (futex).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARWAITER_H_
+#define EMCIRCULARWAITER_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_WAITER_MAX_RINGS 256 // Maximum number of buffers registered in a waiter
+
+/*
+ * Definition of the conditions that can be waited, they can be combined
+ */
+#define CB_WAIT_READABLE 0x01u // the buffer is not empty
+#define CB_WAIT_WRITABLE 0x02u // the buffer is not full
+
+/*
+ * Definition of the waiter data type
+ */
+typedef struct CBWaiter_t
+{
+	CBuffer_t *rings[CB_WAITER_MAX_RINGS];	// buffers registered
+	uint32_t events[CB_WAITER_MAX_RINGS];	// conditions waited on every buffer
+	size_t nbRings;							// number of buffers registered
+	uint32_t futexWord;						// incremented on every notification seen by a sleeper
+	uint32_t nbSleepers;					// number of threads inside emCircularWaiterWait()
+	uint32_t nbWakeAll;						// number of calls of emCircularWaiterWakeAll()
+} CBWaiter_t;
+
+/*
+ * @brief This function initializes the waiter.
+ *
+ * @return CBWaiter_t*, pointer to the waiter created. Returns
+ * 		NULL if it was not possible to create the waiter
+ */
+CBWaiter_t *emCircularWaiterInit(void);
+
+/*
+ * @brief This function deletes the waiter, removing its callback from all
+ * 		the buffers registered. No thread must be waiting.
+ *
+ * @param waiter, pointer to the waiter to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularWaiterDelete(CBWaiter_t *waiter);
+
+/*
+ * @brief This function registers a buffer in the waiter, or changes the
+ * 		conditions waited if it is already registered. The notify callback of
+ * 		the buffer is replaced, so a buffer can be registered in one waiter only.
+ * 		It must not be called while a thread is waiting.
+ *
+ * @param waiter, pointer to the waiter to be used
+ * @param buffer, pointer to the circular buffer to be registered
+ * @param events, conditions to be waited (CB_WAIT_READABLE, CB_WAIT_WRITABLE)
+ * @return CBStatus_t, return value. Returns CB_true if the buffer was
+ * 		registered, CB_error otherwise
+ */
+CBStatus_t emCircularWaiterAdd(CBWaiter_t *waiter, CBuffer_t *buffer, const uint32_t events);
+
+/*
+ * @brief This function removes a buffer from the waiter and clears its notify
+ * 		callback. It must not be called while a thread is waiting.
+ *
+ * @param waiter, pointer to the waiter to be used
+ * @param buffer, pointer to the circular buffer to be removed
+ * @return CBStatus_t, return value. Returns CB_true if the buffer was
+ * 		removed, CB_false if it was not registered
+ */
+CBStatus_t emCircularWaiterRemove(CBWaiter_t *waiter, CBuffer_t *buffer);
+
+/*
+ * @brief This function blocks until at least one of the buffers registered
+ * 		satisfies the conditions waited, or the timeout expires.
+ *
+ * @param waiter, pointer to the waiter to be used
+ * @param ready, array filled with the indexes (in order of registration) of
+ * 		the buffers ready. Can be NULL if maxReady is 0
+ * @param readyEvents, array filled with the conditions satisfied by every
+ * 		buffer in ready. Can be NULL
+ * @param maxReady, size of the ready arrays
+ * @param timeoutMs, maximum time to wait in milliseconds. Negative to wait
+ * 		forever, 0 to only check the buffers
+ * @return size_t, number of buffers ready, also beyond maxReady. Returns 0
+ * 		if the timeout expired or emCircularWaiterWakeAll() was called
+ */
+size_t emCircularWaiterWait(CBWaiter_t *waiter, size_t *ready, uint32_t *readyEvents, const size_t maxReady,
+							const int timeoutMs);
+
+/*
+ * @brief This function wakes all the threads waiting on the waiter, that
+ * 		return even if no buffer is ready, e.g. to make them check a stop condition.
+ *
+ * @param waiter, pointer to the waiter to be used
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularWaiterWakeAll(CBWaiter_t *waiter);
+
+#endif /* EMCIRCULARWAITER_H_ */
@@ -0,0 +1,252 @@
+/*
+ * @file emCircularWheel.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularWheel.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+#define CB_WHEEL_NIL UINT32_MAX // index of no entry
+
+/*
+ * Links an entry in the bucket of its expiry, in the lowest level whose range
+ * contains the ticks left. A bucket up to a whole turn ahead is reached when the
+ * level below wraps into it, so it is always reached before the expiry; an expiry
+ * beyond the last level is moved again when its bucket is reached.
+ */
+static void emCircularWheelLink(CBWheel_t *wheel, const uint32_t ind)
+{
+	CBWheelEntry_t *entry = &wheel->entries[ind];
+	uint64_t delta = entry->expiry - wheel->now;
+	size_t level = 0;
+	while ((level < (CB_WHEEL_LEVELS - 1)) && ((delta >> (CB_WHEEL_BITS * (level + 1))) != 0))
+	{
+		level++;
+	}
+	size_t slot = (size_t)(entry->expiry >> (CB_WHEEL_BITS * level)) & (CB_WHEEL_SLOTS - 1);
+	uint32_t bucket = (uint32_t)((level * CB_WHEEL_SLOTS) + slot);
+	entry->bucket = bucket;
+	entry->prev = CB_WHEEL_NIL;
+	entry->next = wheel->buckets[bucket];
+	if (entry->next != CB_WHEEL_NIL)
+	{
+		wheel->entries[entry->next].prev = ind;
+	}
+	wheel->buckets[bucket] = ind;
+}
+
+/*
+ * Removes an entry from its bucket
+ */
+static void emCircularWheelUnlink(CBWheel_t *wheel, const uint32_t ind)
+{
+	CBWheelEntry_t *entry = &wheel->entries[ind];
+	if (entry->prev != CB_WHEEL_NIL)
+	{
+		wheel->entries[entry->prev].next = entry->next;
+	}
+	else
+	{
+		wheel->buckets[entry->bucket] = entry->next;
+	}
+	if (entry->next != CB_WHEEL_NIL)
+	{
+		wheel->entries[entry->next].prev = entry->prev;
+	}
+	entry->bucket = CB_WHEEL_NIL;
+}
+
+/*
+ * Gives an entry back to the free list, invalidating its handle
+ */
+static void emCircularWheelFree(CBWheel_t *wheel, const uint32_t ind)
+{
+	CBWheelEntry_t *entry = &wheel->entries[ind];
+	entry->generation++;
+	entry->next = wheel->freeList;
+	wheel->freeList = ind;
+	wheel->nbTimers--;
+}
+
+/*
+ * Moves the timers of a bucket of an upper level to the levels below.
+ * The bucket is detached first, so the entries can be linked again in it.
+ */
+static void emCircularWheelCascade(CBWheel_t *wheel, const uint32_t bucket)
+{
+	uint32_t ind = wheel->buckets[bucket];
+	wheel->buckets[bucket] = CB_WHEEL_NIL;
+	while (ind != CB_WHEEL_NIL)
+	{
+		uint32_t next = wheel->entries[ind].next;
+		emCircularWheelLink(wheel, ind);
+		ind = next;
+	}
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBWheel_t *emCircularWheelInit(const size_t capacity, const size_t payloadSize, const uint64_t now)
+{
+	if ((capacity < 1) || (capacity >= CB_WHEEL_NIL))
+		return NULL;
+	if (payloadSize < 1)
+		return NULL;
+	CBWheel_t *retval = (CBWheel_t *)emCircularPortMalloc(sizeof(CBWheel_t));
+	if (retval == NULL)
+		return NULL;
+	retval->entries = (CBWheelEntry_t *)emCircularPortMalloc(capacity * sizeof(CBWheelEntry_t));
+	retval->payloads = (unsigned char *)emCircularPortMalloc(capacity * payloadSize);
+	if ((retval->entries == NULL) || (retval->payloads == NULL))
+	{
+		CB_DEBUG_Print("CB Error:\tCannot allocate the timers of the wheel!\r\n");
+		emCircularWheelDelete(retval);
+		return NULL;
+	}
+	for (size_t i = 0; i < capacity; i++)
+	{
+		retval->entries[i].next = ((i + 1) < capacity) ? (uint32_t)(i + 1) : CB_WHEEL_NIL;
+		retval->entries[i].bucket = CB_WHEEL_NIL;
+		retval->entries[i].generation = 0;
+	}
+	for (size_t i = 0; i < (CB_WHEEL_LEVELS * CB_WHEEL_SLOTS); i++)
+	{
+		retval->buckets[i] = CB_WHEEL_NIL;
+	}
+	retval->payloadSize = payloadSize;
+	retval->capacity = capacity;
+	retval->freeList = 0;
+	retval->nbTimers = 0;
+	retval->now = now;
+	CB_DEBUG_Print("CB:\tTiming wheel initialised. Wheel pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularWheelDelete(CBWheel_t *wheel)
+{
+	if (wheel == NULL)
+		return CB_error;
+	if (wheel->entries != NULL)
+		emCircularPortFree(wheel->entries);
+	if (wheel->payloads != NULL)
+		emCircularPortFree(wheel->payloads);
+	emCircularPortFree(wheel);
+	return CB_true;
+}
+
+void *emCircularWheelSchedule(CBWheel_t *wheel, uint64_t delay, uint64_t *handle)
+{
+	if (wheel == NULL)
+		return NULL;
+	if (wheel->freeList == CB_WHEEL_NIL)
+	{
+		CB_DEBUG_Print("CB:\tThe timing wheel is full.\r\n");
+		return NULL;
+	}
+	/* The bucket of the current tick was already expired */
+	if (delay < 1)
+	{
+		delay = 1;
+	}
+	uint32_t ind = wheel->freeList;
+	CBWheelEntry_t *entry = &wheel->entries[ind];
+	wheel->freeList = entry->next;
+	wheel->nbTimers++;
+	entry->expiry = ((UINT64_MAX - wheel->now) > delay) ? (wheel->now + delay) : UINT64_MAX;
+	emCircularWheelLink(wheel, ind);
+	if (handle != NULL)
+	{
+		*handle = ((uint64_t)entry->generation << 32) | ind;
+	}
+	return wheel->payloads + ((size_t)ind * wheel->payloadSize);
+}
+
+CBStatus_t emCircularWheelCancel(CBWheel_t *wheel, const uint64_t handle)
+{
+	if (wheel == NULL)
+		return CB_error;
+	uint32_t ind = (uint32_t)handle;
+	if (ind >= wheel->capacity)
+		return CB_error;
+	CBWheelEntry_t *entry = &wheel->entries[ind];
+	if ((entry->generation != (uint32_t)(handle >> 32)) || (entry->bucket == CB_WHEEL_NIL))
+		return CB_false;
+	emCircularWheelUnlink(wheel, ind);
+	emCircularWheelFree(wheel, ind);
+	return CB_true;
+}
+
+size_t emCircularWheelAdvance(CBWheel_t *wheel, const uint64_t now, CBWheelFn_t fn, void *arg)
+{
+	if (wheel == NULL)
+		return 0;
+	size_t retval = 0;
+	while (wheel->now < now)
+	{
+		/* With no timers there is nothing to move, the wheel jumps to the end */
+		if (wheel->nbTimers == 0)
+		{
+			wheel->now = now;
+			break;
+		}
+		wheel->now++;
+		/* When a level wraps, the bucket reached in the level above is moved down */
+		for (size_t level = 1; level < CB_WHEEL_LEVELS; level++)
+		{
+			if ((wheel->now & ((1ull << (CB_WHEEL_BITS * level)) - 1)) != 0)
+				break;
+			size_t slot = (size_t)(wheel->now >> (CB_WHEEL_BITS * level)) & (CB_WHEEL_SLOTS - 1);
+			emCircularWheelCascade(wheel, (uint32_t)((level * CB_WHEEL_SLOTS) + slot));
+		}
+		uint32_t bucket = (uint32_t)(wheel->now & (CB_WHEEL_SLOTS - 1));
+		uint32_t ind;
+		while ((ind = wheel->buckets[bucket]) != CB_WHEEL_NIL)
+		{
+			emCircularWheelUnlink(wheel, ind);
+			if (fn != NULL)
+			{
+				fn(wheel->payloads + ((size_t)ind * wheel->payloadSize),
+				   ((uint64_t)wheel->entries[ind].generation << 32) | ind, arg);
+			}
+			emCircularWheelFree(wheel, ind);
+			retval++;
+		}
+	}
+	return retval;
+}
+
+size_t emCircularWheelGetNbTimers(const CBWheel_t *wheel)
+{
+	if (wheel == NULL)
+		return 0;
+	return wheel->nbTimers;
+}
@@ -0,0 +1,145 @@
+/*
+ * @file emCircularWheel.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a hierarchical timing wheel.
+ *
+ * The wheel has CB_WHEEL_LEVELS levels of 2^CB_WHEEL_BITS buckets; every level
+ * covers a range of ticks 2^CB_WHEEL_BITS times larger than the one below it.
+ * A timer is put in the bucket of the lowest level that contains its expiry and,
+ * when the time reaches that bucket, it is moved down one level until it expires
+ * from the first one. The timers live in an arena of entries allocated once, and
+ * every bucket is a doubly linked list of arena indexes, so schedule and cancel
+ * are O(1), a tick expires a whole bucket at once and there is no allocation after
+ * the initialisation. The wheel is not thread safe, it is meant to be owned by
+ * the thread running the timers (e.g. an event loop).
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARWHEEL_H_
+#define EMCIRCULARWHEEL_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * User defines for configuration
+ */
+#define CB_WHEEL_BITS 6		// log2 of the number of buckets of every level
+#define CB_WHEEL_LEVELS 4	// number of levels, the wheel covers 2^(BITS * LEVELS) ticks
+
+#define CB_WHEEL_SLOTS (1u << CB_WHEEL_BITS)
+#define CB_WHEEL_NONE UINT64_MAX // handle of no timer
+
+/*
+ * Definition of the function called for every timer expired
+ */
+typedef void (*CBWheelFn_t)(void *payload, uint64_t handle, void *arg);
+
+/*
+ * Definition of a timer entry of the arena
+ */
+typedef struct CBWheelEntry_t
+{
+	uint64_t expiry;		// tick when the timer expires
+	uint32_t next;			// next entry of the bucket or of the free list
+	uint32_t prev;			// previous entry of the bucket
+	uint32_t bucket;		// bucket of the entry, CB_WHEEL_NIL if not scheduled
+	uint32_t generation;	// incremented when the entry is freed, to detect old handles
+} CBWheelEntry_t;
+
+/*
+ * Definition of the timing wheel data type
+ */
+typedef struct CBWheel_t
+{
+	CBWheelEntry_t *entries;	// arena of the timers
+	unsigned char *payloads;	// user data of every timer
+	size_t payloadSize;			// size in bytes of the user data of a timer
+	size_t capacity;			// maximum number of timers
+	uint32_t freeList;			// first entry not used
+	size_t nbTimers;			// number of timers scheduled
+	uint64_t now;				// current tick
+	uint32_t buckets[CB_WHEEL_LEVELS * CB_WHEEL_SLOTS]; // first entry of every bucket
+} CBWheel_t;
+
+/*
+ * @brief This function initializes the timing wheel allocating the arena
+ * 		of the timers.
+ *
+ * @param capacity, maximum number of timers scheduled at the same time
+ * @param payloadSize, size of the user data of every timer in terms of bytes
+ * @param now, current tick
+ * @return CBWheel_t*, pointer to the wheel created. Returns
+ * 		NULL if it was not possible to create the wheel
+ */
+CBWheel_t *emCircularWheelInit(const size_t capacity, const size_t payloadSize, const uint64_t now);
+
+/*
+ * @brief This function deletes the timing wheel and frees its memory.
+ *
+ * @param wheel, pointer to the wheel to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularWheelDelete(CBWheel_t *wheel);
+
+/*
+ * @brief This function is used to get the user data of a new timer, to be
+ * 		written by the caller. The timer expires after delay ticks, at least one.
+ * 		Timers beyond the range of the wheel are moved down when it is reached.
+ *
+ * @param wheel, pointer to the wheel to be used
+ * @param delay, number of ticks before the timer expires
+ * @param handle, filled with the handle of the timer, used to cancel it. Can be NULL
+ * @return void*, pointer to the user data of the timer. Returns NULL if
+ * 		the arena is full
+ */
+void *emCircularWheelSchedule(CBWheel_t *wheel, uint64_t delay, uint64_t *handle);
+
+/*
+ * @brief This function cancels a timer.
+ *
+ * @param wheel, pointer to the wheel to be used
+ * @param handle, handle of the timer
+ * @return CBStatus_t, return value. Returns CB_true if the timer was
+ * 		cancelled, CB_false if it already expired or was cancelled
+ */
+CBStatus_t emCircularWheelCancel(CBWheel_t *wheel, const uint64_t handle);
+
+/*
+ * @brief This function moves the wheel forward to the tick now, calling fn
+ * 		for every timer expired, in order of tick. The timer is freed when fn
+ * 		returns; fn can schedule and cancel other timers.
+ *
+ * @param wheel, pointer to the wheel to be used
+ * @param now, current tick
+ * @param fn, function called for every timer expired
+ * @param arg, user argument passed to fn
+ * @return size_t, number of timers expired
+ */
+size_t emCircularWheelAdvance(CBWheel_t *wheel, const uint64_t now, CBWheelFn_t fn, void *arg);
+
+/*
+ * @brief This function returns the number of timers scheduled.
+ *
+ * @param wheel, pointer to the wheel to be checked
+ * @return size_t, number of timers
+ */
+size_t emCircularWheelGetNbTimers(const CBWheel_t *wheel);
+
+#endif /* EMCIRCULARWHEEL_H_ */
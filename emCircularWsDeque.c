@@ -0,0 +1,147 @@
+/*
+ * @file emCircularWsDeque.c
+ * @author Mannone Vito
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include "emCircularWsDeque.h"
+#include "emCircularPort.h"
+
+/*
+ * PRIVATE FUNCTIONS
+ */
+#if CB_DEBUG
+#include <stdio.h>
+#define CB_DEBUG_Print(...) printf(__VA_ARGS__)
+#else
+#define CB_DEBUG_Print(...)
+#endif
+
+/*
+ * Returns the pointer to the element with the given free-running index
+ */
+static unsigned char *emCircularWsDequeSlot(const CBWsDeque_t *deque, const size_t index)
+{
+	return deque->startBuffer + ((index & deque->mask) * deque->elemSize);
+}
+
+/*
+ * PUBLIC FUNCTIONS
+ */
+
+CBWsDeque_t *emCircularWsDequeInit(const size_t maxElems, const size_t elemSize)
+{
+	if ((maxElems < 2) || ((maxElems & (maxElems - 1)) != 0))
+		return NULL;
+	if (elemSize < 1)
+		return NULL;
+	CBWsDeque_t *retval = (CBWsDeque_t *)emCircularPortMalloc(sizeof(CBWsDeque_t));
+	if (retval == NULL)
+		return NULL;
+	retval->startBuffer = (unsigned char *)emCircularPortMalloc(maxElems * elemSize);
+	if (retval->startBuffer == NULL)
+	{
+		emCircularPortFree(retval);
+		return NULL;
+	}
+	retval->top = 0;
+	retval->bottom = 0;
+	retval->elemSize = elemSize;
+	retval->mask = maxElems - 1;
+	CB_DEBUG_Print("CB:\tWork-stealing deque initialised. Deque pointer is %p.\r\n", retval);
+	return retval;
+}
+
+CBStatus_t emCircularWsDequeDelete(CBWsDeque_t *deque)
+{
+	if (deque == NULL)
+		return CB_error;
+	emCircularPortFree(deque->startBuffer);
+	emCircularPortFree(deque);
+	return CB_true;
+}
+
+CBStatus_t emCircularWsDequePush(CBWsDeque_t *deque, const void *elem)
+{
+	if ((deque == NULL) || (elem == NULL))
+		return CB_error;
+	size_t bottom = deque->bottom;
+	size_t top = emCircularPort_AtomicLoad(&deque->top);
+	if ((bottom - top) > deque->mask)
+	{
+		CB_DEBUG_Print("CB:\tDeque is full.\r\n");
+		return CB_false;
+	}
+	memcpy(emCircularWsDequeSlot(deque, bottom), elem, deque->elemSize);
+	emCircularPort_AtomicStore(&deque->bottom, bottom + 1);
+	return CB_true;
+}
+
+CBStatus_t emCircularWsDequePop(CBWsDeque_t *deque, void *elem)
+{
+	if ((deque == NULL) || (elem == NULL))
+		return CB_error;
+	size_t bottom = deque->bottom - 1;
+	emCircularPort_AtomicStore(&deque->bottom, bottom);
+	emCircularPort_AtomicFence();
+	size_t top = emCircularPort_AtomicLoad(&deque->top);
+	if ((ptrdiff_t)(bottom - top) < 0)
+	{
+		emCircularPort_AtomicStore(&deque->bottom, bottom + 1);
+		return CB_false;
+	}
+	memcpy(elem, emCircularWsDequeSlot(deque, bottom), deque->elemSize);
+	if (bottom != top)
+		return CB_true;
+
+	/* Last element: the thieves can take it too */
+	CBStatus_t retval = CB_false;
+	if (emCircularPort_AtomicCAS(&deque->top, &top, top + 1))
+	{
+		retval = CB_true;
+	}
+	emCircularPort_AtomicStore(&deque->bottom, bottom + 1);
+	return retval;
+}
+
+CBStatus_t emCircularWsDequeSteal(CBWsDeque_t *deque, void *elem)
+{
+	if ((deque == NULL) || (elem == NULL))
+		return CB_error;
+	size_t top = emCircularPort_AtomicLoad(&deque->top);
+	emCircularPort_AtomicFence();
+	size_t bottom = emCircularPort_AtomicLoad(&deque->bottom);
+	if ((ptrdiff_t)(bottom - top) <= 0)
+		return CB_false;
+	memcpy(elem, emCircularWsDequeSlot(deque, top), deque->elemSize);
+	if (!emCircularPort_AtomicCAS(&deque->top, &top, top + 1))
+		return CB_false;
+	return CB_true;
+}
+
+size_t emCircularWsDequeGetSize(const CBWsDeque_t *deque)
+{
+	if (deque == NULL)
+		return 0;
+	size_t top = emCircularPort_AtomicLoad(&deque->top);
+	size_t bottom = emCircularPort_AtomicLoad(&deque->bottom);
+	if ((ptrdiff_t)(bottom - top) <= 0)
+		return 0;
+	return bottom - top;
+}
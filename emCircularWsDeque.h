@@ -0,0 +1,111 @@
+/*
+ * @file emCircularWsDeque.h
+ * @author: Mannone Vito
+ *
+ * @brief This module implements a Chase-Lev work-stealing deque with the same
+ * storage model of emCircularBuffer: fixed-size elements in a contiguous buffer
+ * allocated with emCircularPortMalloc(), with a power of two capacity.
+ *
+ * The owner thread pushes and pops elements at the bottom (LIFO) and the other
+ * threads steal elements from the top (FIFO). The owner does not use atomic
+ * read-modify-write operations, except when it competes with a thief for the
+ * last element; the thieves steal with a compare and swap.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EMCIRCULARWSDEQUE_H_
+#define EMCIRCULARWSDEQUE_H_
+
+#include "emCircularBuffer.h"
+
+/*
+ * Definition of the work-stealing deque data type
+ */
+typedef struct CBWsDeque_t
+{
+	size_t top;					// index of the next element to be stolen, moved by the thieves
+	size_t bottom;				// index of the next free element, moved by the owner only
+	unsigned char *startBuffer; // pointer of the first address of the buffer used
+	size_t elemSize;			// dimension of the elements of the deque
+	size_t mask;				// dimension of the buffer in terms of number of elements, minus 1
+} CBWsDeque_t;
+
+/*
+ * @brief This function initializes the deque allocating the necessary memory for it.
+ *
+ * @param maxElems, number of elements of the deque. Must be a power of two
+ * @param elemSize, size of every element in terms of bytes
+ * @return CBWsDeque_t*, pointer to the deque created. Returns
+ * 		NULL if it was not possible to create the deque
+ */
+CBWsDeque_t *emCircularWsDequeInit(const size_t maxElems, const size_t elemSize);
+
+/*
+ * @brief This function deletes and frees all the memory dedicated to the deque.
+ *
+ * @param deque, pointer to the deque to be deleted
+ * @return CBStatus_t, return value.
+ */
+CBStatus_t emCircularWsDequeDelete(CBWsDeque_t *deque);
+
+/*
+ * @brief This function copies an element at the bottom of the deque.
+ * 		Must be called by the owner thread only.
+ *
+ * @param deque, pointer to the deque to be used
+ * @param elem, pointer to the element to be copied
+ * @return CBStatus_t, return value. Returns CB_true if the element was
+ * 		pushed, CB_false if the deque is full
+ */
+CBStatus_t emCircularWsDequePush(CBWsDeque_t *deque, const void *elem);
+
+/*
+ * @brief This function takes the last element pushed in the deque.
+ * 		Must be called by the owner thread only.
+ *
+ * @param deque, pointer to the deque to be used
+ * @param elem, pointer where the element is copied. Its content is not
+ * 		valid if the function does not return CB_true
+ * @return CBStatus_t, return value. Returns CB_true if an element was taken,
+ * 		CB_false if the deque is empty or the last element was stolen
+ */
+CBStatus_t emCircularWsDequePop(CBWsDeque_t *deque, void *elem);
+
+/*
+ * @brief This function steals the oldest element of the deque.
+ * 		It can be called by any thread.
+ *
+ * @param deque, pointer to the deque to be used
+ * @param elem, pointer where the element is copied. Its content is not
+ * 		valid if the function does not return CB_true
+ * @return CBStatus_t, return value. Returns CB_true if an element was stolen,
+ * 		CB_false if the deque is empty or another thread took the element first
+ */
+CBStatus_t emCircularWsDequeSteal(CBWsDeque_t *deque, void *elem);
+
+/*
+ * @brief This function is used to know how many elements are in the deque.
+ * 		The value can be already old when it is returned.
+ *
+ * @param deque, pointer to the deque to be checked
+ * @return size_t, number of elements
+ */
+size_t emCircularWsDequeGetSize(const CBWsDeque_t *deque);
+
+#endif /* EMCIRCULARWSDEQUE_H_ */